@@ -0,0 +1,61 @@
+#ifndef CHILD_LIST_HPP
+#define CHILD_LIST_HPP
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+/// The child pointers of a tree node.
+/// For small K the children are stored inline in a fixed array next to the node value,
+/// so a node needs no extra allocation and its children share its cache lines.
+/// For large K the list falls back to a std::vector.
+/// @tparam Ptr The child pointer type.
+/// @tparam K The maximum number of children.
+/// @tparam Inline Whether the children are stored inline.
+template <typename Ptr, int K, bool Inline = (K <= 8)>
+class ChildList {
+    static_assert(K > 0 && K <= 255, "inline child lists hold between 1 and 255 children");
+
+    std::array<Ptr, K> slots;
+    unsigned char count;
+
+public:
+    typedef Ptr* iterator;
+    typedef const Ptr* const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    ChildList() : count(0) {}
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    /// Append a child; the caller makes sure fewer than K children are stored.
+    /// @param child The child to append.
+    void push_back(Ptr child) { slots[count++] = child; }
+    void pop_back() { --count; }
+    void clear() { count = 0; }
+
+    Ptr& operator[](std::size_t i) { return slots[i]; }
+    const Ptr& operator[](std::size_t i) const { return slots[i]; }
+    Ptr& front() { return slots[0]; }
+    const Ptr& front() const { return slots[0]; }
+    Ptr& back() { return slots[count - 1]; }
+    const Ptr& back() const { return slots[count - 1]; }
+
+    iterator begin() { return slots.data(); }
+    iterator end() { return slots.data() + count; }
+    const_iterator begin() const { return slots.data(); }
+    const_iterator end() const { return slots.data() + count; }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+};
+
+/// Child list for large K, stored in a std::vector.
+template <typename Ptr, int K>
+class ChildList<Ptr, K, false> : public std::vector<Ptr> {};
+
+#endif
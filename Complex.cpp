@@ -7,6 +7,19 @@ std::ostream& operator<<(std::ostream& os, const Complex& c) {
     return os;
 }
 
+std::istream& operator>>(std::istream& is, Complex& c) {
+    char open = 0, comma = 0, close = 0;
+    double r = 0.0, i = 0.0;
+    if (is >> open >> r >> comma >> i >> close) {
+        if (open == '(' && comma == ',' && close == ')') {
+            c = Complex(r, i);
+        } else {
+            is.setstate(std::ios::failbit);
+        }
+    }
+    return is;
+}
+
 bool Complex::operator==(const Complex& other) const {
     return real == other.real && imag == other.imag;
 }
@@ -19,6 +19,12 @@ public:
     /// @return Reference to the output stream.
     friend std::ostream& operator<<(std::ostream& os, const Complex& c);
 
+    /// @brief Overloaded input stream operator reading the "(real, imag)" form written by operator<<.
+    /// @param is Input stream.
+    /// @param c Complex number to read into.
+    /// @return Reference to the input stream, with failbit set if the input is not in that form.
+    friend std::istream& operator>>(std::istream& is, Complex& c);
+
     /// @brief Equality operator to compare two complex numbers.
     /// @param other Another complex number to compare with.
     /// @return True if both real and imaginary parts are equal.
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include "Tree.hpp"
+#include "TreeViewer.hpp"
 
 using namespace std;
 
@@ -93,7 +94,11 @@ int main(int argc, char *argv[]) {
     cout << endl;
     // same as BFS: 1.1, 1.2, 1.3, 1.4, 1.5, 1.6
 
-    std::cout << tree;
+    std::cout << tree << std::endl;
+    // prints: 1.1[1.2[1.4, 1.5], 1.3[1.6]]
+
+    // Opens a window with the tree once the event loop below runs.
+    show_async(tree);
         
     Tree<double, 3> three_ary_tree; // 3-ary tree.
     three_ary_tree.add_root(root_node);
@@ -0,0 +1,456 @@
+#ifndef FLAT_TREE_HPP
+#define FLAT_TREE_HPP
+
+#include "Node.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+template <typename T, int K, typename Index, typename Alloc>
+class Tree;
+
+/// A read-only, structure-of-arrays copy of a Tree.
+/// The nodes are numbered in BFS order and stored in contiguous arrays of values,
+/// parent indices, first-child indices and child counts, linked by 32-bit indices instead of pointers.
+/// Because BFS numbering keeps the children of a node next to each other, every traversal
+/// walks the arrays without any auxiliary stack or queue.
+/// The traversals follow the same orders as the iterators of Tree<T, K>.
+///
+/// For trivially copyable T the arrays can be saved to a binary file with save() and reopened
+/// with map_file() from FlatTreeFile.hpp, which maps the file into memory and reads the arrays in place.
+template <typename T, int K = 2>
+class FlatTree {
+public:
+    /// Index used for "no node", e.g. the parent of the root.
+    static const std::uint32_t npos = 0xFFFFFFFFu;
+
+private:
+    /// Leading part of a saved file. The four arrays follow, each starting on an 8-byte boundary.
+    struct FileHeader {
+        char magic[8];             ///< "KARYTREE".
+        std::uint32_t version;     ///< Format version, 1.
+        std::uint32_t arity;       ///< K.
+        std::uint64_t value_size;  ///< sizeof(Node<T>).
+        std::uint64_t count;       ///< Number of nodes.
+    };
+
+    // Storage of a flat tree built in memory; empty for a mapped file.
+    std::vector<Node<T>> value_storage;
+    std::vector<std::uint32_t> parent_storage;
+    std::vector<std::uint32_t> first_child_storage;
+    std::vector<std::uint32_t> child_count_storage;
+    std::shared_ptr<void> mapping; ///< The mapped file, unmapped with the last copy.
+
+    std::size_t count;
+    const Node<T>* values;               ///< Node values in BFS order.
+    const std::uint32_t* parents;        ///< Parent index of each node, npos for the root.
+    const std::uint32_t* first_children; ///< Index of the first child of each node.
+    const std::uint32_t* child_counts;   ///< Number of children of each node.
+
+public:
+    /// Construct an empty flat tree.
+    FlatTree() {
+        point_to_storage();
+    }
+
+    /// Copy the structure and values of a tree.
+    /// @param tree The tree to copy.
+    template <typename Index, typename Alloc>
+    explicit FlatTree(const Tree<T, K, Index, Alloc>& tree) {
+        typedef typename Tree<T, K, Index, Alloc>::NodeHandle Handle;
+        if (tree.size() >= npos) {
+            throw std::length_error("FlatTree supports at most 2^32 - 1 nodes");
+        }
+        std::vector<Handle> order;
+        order.reserve(tree.size());
+        value_storage.reserve(tree.size());
+        parent_storage.reserve(tree.size());
+        first_child_storage.reserve(tree.size());
+        child_count_storage.reserve(tree.size());
+        if (tree.root_handle()) {
+            order.push_back(tree.root_handle());
+            parent_storage.push_back(npos);
+        }
+        // The order vector doubles as the BFS queue.
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            Handle node = order[i];
+            value_storage.push_back(*node);
+            first_child_storage.push_back(static_cast<std::uint32_t>(order.size()));
+            child_count_storage.push_back(static_cast<std::uint32_t>(node.child_count()));
+            for (std::size_t c = 0; c < node.child_count(); ++c) {
+                order.push_back(node.child(c));
+                parent_storage.push_back(static_cast<std::uint32_t>(i));
+            }
+        }
+        point_to_storage();
+    }
+
+    FlatTree(const FlatTree& other)
+        : value_storage(other.value_storage), parent_storage(other.parent_storage),
+          first_child_storage(other.first_child_storage), child_count_storage(other.child_count_storage),
+          mapping(other.mapping) {
+        point_to(other);
+    }
+
+    FlatTree(FlatTree&& other) noexcept
+        : value_storage(std::move(other.value_storage)), parent_storage(std::move(other.parent_storage)),
+          first_child_storage(std::move(other.first_child_storage)), child_count_storage(std::move(other.child_count_storage)),
+          mapping(std::move(other.mapping)) {
+        point_to(other);
+        other.clear();
+    }
+
+    FlatTree& operator=(const FlatTree& other) {
+        if (this != &other) {
+            FlatTree copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    FlatTree& operator=(FlatTree&& other) noexcept {
+        if (this != &other) {
+            value_storage = std::move(other.value_storage);
+            parent_storage = std::move(other.parent_storage);
+            first_child_storage = std::move(other.first_child_storage);
+            child_count_storage = std::move(other.child_count_storage);
+            mapping = std::move(other.mapping);
+            point_to(other);
+            other.clear();
+        }
+        return *this;
+    }
+
+    /// Save the tree to a binary file in the native byte order.
+    /// @param path The file to write.
+    /// @throws std::runtime_error if the file cannot be written.
+    void save(const std::string& path) const {
+        static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be saved");
+        static_assert(alignof(Node<T>) <= 8, "values must fit the 8-byte alignment of the file layout");
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("FlatTree::save: cannot open " + path);
+        }
+        FileHeader header = make_header(count);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_array(out, values, count);
+        write_array(out, parents, count);
+        write_array(out, first_children, count);
+        write_array(out, child_counts, count);
+        if (!out.flush()) {
+            throw std::runtime_error("FlatTree::save: cannot write " + path);
+        }
+    }
+
+    /// Open a file written by save() as a read-only view.
+    /// The file is mapped into memory and the arrays are used in place, without copying or allocating nodes.
+    /// The links are checked once in O(N), so a damaged file is refused instead of being read out of bounds.
+    /// Defined in FlatTreeFile.hpp, which holds the platform file mapping code.
+    /// @param path The file to open.
+    /// @return The flat tree, valid for as long as it or one of its copies exists.
+    /// @throws std::runtime_error if the file cannot be mapped, was not saved by a FlatTree<T, K>
+    ///         or its links do not describe a tree in BFS order.
+    static FlatTree map_file(const std::string& path);
+
+    /// Get the number of nodes.
+    /// @return The number of nodes.
+    std::size_t size() const { return count; }
+
+    /// Check whether the tree has no nodes.
+    /// @return True if the tree is empty.
+    bool empty() const { return count == 0; }
+
+    /// Get the value of a node.
+    /// @param i The BFS index of the node.
+    /// @return The value of the node.
+    const Node<T>& value(std::uint32_t i) const { return values[i]; }
+
+    /// Get the parent of a node.
+    /// @param i The BFS index of the node.
+    /// @return The index of the parent, or npos for the root.
+    std::uint32_t parent(std::uint32_t i) const { return parents[i]; }
+
+    /// Get the first child of a node; the other children follow it.
+    /// @param i The BFS index of the node.
+    /// @return The index of the first child.
+    std::uint32_t first_child(std::uint32_t i) const { return first_children[i]; }
+
+    /// Get the number of children of a node.
+    /// @param i The BFS index of the node.
+    /// @return The number of children.
+    std::uint32_t child_count(std::uint32_t i) const { return child_counts[i]; }
+
+    /// Base of the traversal iterators: a position in the arrays.
+    class Iterator {
+    protected:
+        const FlatTree* tree;
+        std::uint32_t pos;
+        Iterator(const FlatTree* tree, std::uint32_t pos) : tree(tree), pos(pos) {}
+    public:
+        bool operator==(const Iterator& other) const { return pos == other.pos; }
+        bool operator!=(const Iterator& other) const { return pos != other.pos; }
+
+        const Node<T>& operator*() const { return tree->values[pos]; }
+        const Node<T>* operator->() const { return &tree->values[pos]; }
+
+        /// Get the BFS index of the current node.
+        /// @return The index.
+        std::uint32_t index() const { return pos; }
+    };
+
+    /// Pre-order traversal iterator. dfs output = pre_order output here
+    class PreOrderIterator : public Iterator {
+    public:
+        PreOrderIterator(const FlatTree* tree, std::uint32_t pos) : Iterator(tree, pos) {}
+
+        PreOrderIterator& operator++() {
+            this->pos = this->tree->next_pre_order(this->pos);
+            return *this;
+        }
+    };
+
+    /// Post-order traversal iterator. run dfs if non binary
+    class PostOrderIterator : public Iterator {
+    public:
+        PostOrderIterator(const FlatTree* tree, std::uint32_t pos) : Iterator(tree, pos) {}
+
+        PostOrderIterator& operator++() {
+            this->pos = K == 2 ? this->tree->next_post_order(this->pos) : this->tree->next_pre_order(this->pos);
+            return *this;
+        }
+    };
+
+    /// In-order traversal iterator. run dfs if non binary
+    class InOrderIterator : public Iterator {
+    public:
+        InOrderIterator(const FlatTree* tree, std::uint32_t pos) : Iterator(tree, pos) {}
+
+        InOrderIterator& operator++() {
+            this->pos = K == 2 ? this->tree->next_in_order(this->pos) : this->tree->next_pre_order(this->pos);
+            return *this;
+        }
+    };
+
+    /// BFS traversal iterator, a plain walk over the arrays.
+    class BFSIterator : public Iterator {
+    public:
+        BFSIterator(const FlatTree* tree, std::uint32_t pos) : Iterator(tree, pos) {}
+
+        BFSIterator& operator++() {
+            ++this->pos;
+            if (this->pos == this->tree->size()) {
+                this->pos = npos;
+            }
+            return *this;
+        }
+    };
+
+    /// DFS traversal iterator.
+    typedef PreOrderIterator DFSIterator;
+
+    /// Heap traversal iterator, visiting the values in ascending order.
+    class HeapIterator {
+        const FlatTree* tree;
+        std::shared_ptr<const std::vector<std::uint32_t>> order; ///< Node indices sorted by value.
+        std::size_t index;
+    public:
+        HeapIterator(const FlatTree* tree, bool at_end) : tree(tree), index(0) {
+            if (!at_end && !tree->empty()) {
+                std::shared_ptr<std::vector<std::uint32_t>> sorted = std::make_shared<std::vector<std::uint32_t>>(tree->size());
+                for (std::size_t i = 0; i < sorted->size(); ++i) {
+                    (*sorted)[i] = static_cast<std::uint32_t>(i);
+                }
+                std::sort(sorted->begin(), sorted->end(), [tree](std::uint32_t a, std::uint32_t b) {
+                    return tree->values[a] < tree->values[b];
+                });
+                order = sorted;
+            }
+        }
+
+        // using this only to check inequality with the end iterator
+        bool operator!=(const HeapIterator& other) const {
+            (void)other; // Explicitly mark as unused
+            return order && index != order->size();
+        }
+
+        const Node<T>& operator*() const {
+            return tree->values[(*order)[index]];
+        }
+
+        HeapIterator& operator++() {
+            ++index;
+            return *this;
+        }
+    };
+
+    PreOrderIterator begin_pre_order() const { return PreOrderIterator(this, empty() ? npos : 0); }
+    PreOrderIterator end_pre_order() const { return PreOrderIterator(this, npos); }
+
+    PostOrderIterator begin_post_order() const {
+        if (empty()) return end_post_order();
+        return PostOrderIterator(this, K == 2 ? leftmost_leaf(0) : 0);
+    }
+    PostOrderIterator end_post_order() const { return PostOrderIterator(this, npos); }
+
+    InOrderIterator begin_in_order() const {
+        if (empty()) return end_in_order();
+        return InOrderIterator(this, K == 2 ? leftmost_leaf(0) : 0);
+    }
+    InOrderIterator end_in_order() const { return InOrderIterator(this, npos); }
+
+    BFSIterator begin_bfs_scan() const { return BFSIterator(this, empty() ? npos : 0); }
+    BFSIterator end_bfs_scan() const { return BFSIterator(this, npos); }
+
+    BFSIterator begin() const { return begin_bfs_scan(); }
+    BFSIterator end() const { return end_bfs_scan(); }
+
+    DFSIterator begin_dfs_scan() const { return begin_pre_order(); }
+    DFSIterator end_dfs_scan() const { return end_pre_order(); }
+
+    HeapIterator begin_heap() const { return HeapIterator(this, false); }
+    HeapIterator end_heap() const { return HeapIterator(this, true); }
+
+private:
+    /// Point the arrays at the own storage.
+    void point_to_storage() {
+        count = value_storage.size();
+        values = value_storage.data();
+        parents = parent_storage.data();
+        first_children = first_child_storage.data();
+        child_counts = child_count_storage.data();
+    }
+
+    /// Point the arrays at the arrays of another tree whose storage or mapping this tree now holds.
+    /// @param other The other tree.
+    void point_to(const FlatTree& other) {
+        if (mapping) {
+            count = other.count;
+            values = other.values;
+            parents = other.parents;
+            first_children = other.first_children;
+            child_counts = other.child_counts;
+        } else {
+            point_to_storage();
+        }
+    }
+
+    /// Reset to an empty tree.
+    void clear() {
+        value_storage.clear();
+        parent_storage.clear();
+        first_child_storage.clear();
+        child_count_storage.clear();
+        mapping.reset();
+        point_to_storage();
+    }
+
+    /// Check that the links describe a tree numbered in BFS order: the root has no parent and
+    /// the children of each node are the next child_count nodes after those of the nodes before it.
+    /// Every link the traversals follow then stays below count.
+    /// @return True if the links are consistent.
+    bool well_formed() const {
+        if (count == 0) return true;
+        if (parents[0] != npos) return false;
+        std::size_t next = 1; // BFS index of the first child of the current node
+        for (std::size_t i = 0; i < count; ++i) {
+            if (child_counts[i] > static_cast<std::uint32_t>(K) || first_children[i] != next ||
+                child_counts[i] > count - next) {
+                return false;
+            }
+            for (std::size_t c = next; c < next + child_counts[i]; ++c) {
+                if (parents[c] != i) return false;
+            }
+            next += child_counts[i];
+        }
+        return next == count;
+    }
+
+    /// The header of a file holding this tree type.
+    /// @param count The number of nodes.
+    /// @return The header.
+    static FileHeader make_header(std::uint64_t count) {
+        FileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "KARYTREE", 8);
+        header.version = 1;
+        header.arity = K;
+        header.value_size = sizeof(Node<T>);
+        header.count = count;
+        return header;
+    }
+
+    /// Round a size up to the 8-byte boundary the arrays start on.
+    static std::size_t padded(std::size_t size) {
+        return (size + 7) & ~static_cast<std::size_t>(7);
+    }
+
+    /// The size of a file holding a number of nodes.
+    static std::size_t file_size(std::uint64_t count) {
+        std::size_t n = static_cast<std::size_t>(count);
+        return sizeof(FileHeader) + padded(n * sizeof(Node<T>)) + 3 * padded(n * sizeof(std::uint32_t));
+    }
+
+    /// Write an array followed by the padding up to the next 8-byte boundary.
+    template <typename U>
+    static void write_array(std::ostream& out, const U* data, std::size_t n) {
+        static const char zeros[8] = {0};
+        out.write(reinterpret_cast<const char*>(data), n * sizeof(U));
+        out.write(zeros, padded(n * sizeof(U)) - n * sizeof(U));
+    }
+
+    /// Get the next sibling of a node.
+    /// @param i The node index.
+    /// @return The index of the next sibling, or npos.
+    std::uint32_t next_sibling(std::uint32_t i) const {
+        std::uint32_t p = parents[i];
+        if (p == npos || i + 1 == first_children[p] + child_counts[p]) return npos;
+        return i + 1;
+    }
+
+    /// Follow first children down to a leaf.
+    /// @param i The starting node.
+    /// @return The index of the leaf.
+    std::uint32_t leftmost_leaf(std::uint32_t i) const {
+        while (child_counts[i] > 0) i = first_children[i];
+        return i;
+    }
+
+    std::uint32_t next_pre_order(std::uint32_t i) const {
+        if (child_counts[i] > 0) return first_children[i];
+        while (i != npos) {
+            std::uint32_t sibling = next_sibling(i);
+            if (sibling != npos) return sibling;
+            i = parents[i];
+        }
+        return npos;
+    }
+
+    std::uint32_t next_post_order(std::uint32_t i) const {
+        std::uint32_t sibling = next_sibling(i);
+        if (sibling != npos) return leftmost_leaf(sibling);
+        return parents[i];
+    }
+
+    std::uint32_t next_in_order(std::uint32_t i) const {
+        // Visit the subtree of the second child, then return to the nearest
+        // ancestor whose first-child subtree we are leaving.
+        if (child_counts[i] > 1) return leftmost_leaf(first_children[i] + 1);
+        while (parents[i] != npos) {
+            std::uint32_t p = parents[i];
+            if (i == first_children[p]) return p;
+            i = p;
+        }
+        return npos;
+    }
+};
+
+template <typename T, int K>
+const std::uint32_t FlatTree<T, K>::npos;
+
+#endif
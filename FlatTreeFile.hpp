@@ -0,0 +1,63 @@
+#ifndef FLAT_TREE_FILE_HPP
+#define FLAT_TREE_FILE_HPP
+
+#include "FlatTree.hpp"
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// FlatTree::map_file(), kept apart from FlatTree.hpp so that Tree.hpp and the other core headers
+// do not pull in the POSIX file mapping headers. Include this header to open saved trees.
+
+template <typename T, int K>
+FlatTree<T, K> FlatTree<T, K>::map_file(const std::string& path) {
+    static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be mapped");
+    static_assert(alignof(Node<T>) <= 8, "values must fit the 8-byte alignment of the file layout");
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("FlatTree::map_file: cannot open " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("FlatTree::map_file: " + path + " is not a tree file");
+    }
+    std::size_t length = static_cast<std::size_t>(info.st_size);
+    void* address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("FlatTree::map_file: cannot map " + path);
+    }
+
+    FlatTree tree;
+    tree.mapping = std::shared_ptr<void>(address, [length](void* p) { ::munmap(p, length); });
+    const char* bytes = static_cast<const char*>(address);
+    const FileHeader& header = *reinterpret_cast<const FileHeader*>(bytes);
+    FileHeader expected = make_header(header.count);
+    if (std::memcmp(&header, &expected, sizeof(FileHeader)) != 0 || header.count >= npos ||
+        length != file_size(header.count)) {
+        throw std::runtime_error("FlatTree::map_file: " + path + " was not saved by this FlatTree type");
+    }
+
+    tree.count = static_cast<std::size_t>(header.count);
+    std::size_t offset = sizeof(FileHeader);
+    tree.values = reinterpret_cast<const Node<T>*>(bytes + offset);
+    offset += padded(tree.count * sizeof(Node<T>));
+    tree.parents = reinterpret_cast<const std::uint32_t*>(bytes + offset);
+    offset += padded(tree.count * sizeof(std::uint32_t));
+    tree.first_children = reinterpret_cast<const std::uint32_t*>(bytes + offset);
+    offset += padded(tree.count * sizeof(std::uint32_t));
+    tree.child_counts = reinterpret_cast<const std::uint32_t*>(bytes + offset);
+    if (!tree.well_formed()) {
+        throw std::runtime_error("FlatTree::map_file: " + path + " is corrupted");
+    }
+    return tree;
+}
+
+#endif
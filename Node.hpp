@@ -4,19 +4,32 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <utility>
+
+/// Tag selecting the Node constructor that builds the value in place from constructor arguments.
+struct InPlace {};
 
 /// A template class representing a node in a tree.
 template <typename T>
 class Node {
     T value; ///< The value of the node.
 public:
-    /// Constructor to initialize the node with a value.
+    /// Constructor to initialize the node with a copy of a value.
+    /// @param val The value to initialize the node with.
+    Node(const T& val) : value(val) {}
+
+    /// Constructor to initialize the node by moving a value in.
     /// @param val The value to initialize the node with.
-    Node(T val) : value(val) {}
+    Node(T&& val) : value(std::move(val)) {}
+
+    /// Constructor to build the value in place.
+    /// @param args The arguments forwarded to the constructor of T.
+    template <typename... Args>
+    explicit Node(InPlace, Args&&... args) : value(std::forward<Args>(args)...) {}
 
     /// Get the value of the node.
-    /// @return The value of the node.
-    T getValue() {
+    /// @return A reference to the value of the node.
+    const T& getValue() const {
         return value;
     }
 
@@ -29,12 +42,24 @@ public:
     }
 
     /// Get the value of the node (const version).
-    /// @return The value of the node.
-    T get_value() const { return value; }
+    /// @return A reference to the value of the node.
+    const T& get_value() const { return value; }
 
     /// Set the value of the node.
     /// @param val The value to set.
-    void set_value(T val) { value = val; }
+    void set_value(const T& val) { value = val; }
+
+    /// Set the value of the node by moving a value in.
+    /// @param val The value to set.
+    void set_value(T&& val) { value = std::move(val); }
+
+    /// Write the value of a node to a stream.
+    /// @param os The output stream.
+    /// @param node The node.
+    /// @return The output stream.
+    friend std::ostream& operator<<(std::ostream& os, const Node& node) {
+        return os << node.value;
+    }
 
     /// Equality operator to compare two nodes.
     /// @param other The other node to compare with.
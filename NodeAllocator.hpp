@@ -0,0 +1,148 @@
+#ifndef NODE_ALLOCATOR_HPP
+#define NODE_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Allocation policy that creates every node with its own new and frees it with delete.
+struct NewDeleteAlloc {
+    /// The node pool stored inside the tree.
+    template <typename U>
+    class pool {
+    public:
+        /// Nodes must be destroyed one by one.
+        static const bool bulk_release = false;
+        /// Nodes can be created from several threads at once.
+        static const bool thread_safe = true;
+
+        /// Every node is allocated on its own, so there is nothing to reserve.
+        void reserve(std::size_t) {}
+
+        /// Create a node.
+        /// @param args The arguments forwarded to the node constructor.
+        /// @return The new node.
+        template <typename... Args>
+        U* create(Args&&... args) {
+            return new U(std::forward<Args>(args)...);
+        }
+
+        /// Destroy a node.
+        /// @param node The node to destroy.
+        void destroy(U* node) {
+            delete node;
+        }
+
+        /// Nothing is owned by the pool itself.
+        void release() {}
+    };
+};
+
+/// Allocation policy that carves nodes out of large contiguous blocks.
+/// Single nodes are never freed; the whole pool is released at once when the tree is cleared,
+/// which frees one block at a time instead of one node at a time.
+/// @tparam BlockSize The number of nodes in each block.
+template <std::size_t BlockSize = 4096>
+struct ArenaAlloc {
+    static_assert(BlockSize > 0, "ArenaAlloc needs a positive block size");
+
+    /// The node pool stored inside the tree.
+    template <typename U>
+    class pool {
+        struct Block {
+            U* slots;          ///< Raw storage for the nodes.
+            std::size_t used;  ///< Number of constructed nodes.
+            std::size_t size;  ///< Number of slots.
+        };
+        std::vector<Block> blocks;
+
+    public:
+        /// Nodes are released together with their block.
+        static const bool bulk_release = true;
+        /// The blocks are shared by every node, so creation is not synchronized.
+        static const bool thread_safe = false;
+
+        pool() {}
+        pool(const pool&) = delete;
+        pool& operator=(const pool&) = delete;
+
+        /// Take over the blocks of another pool.
+        /// @param other The pool to move from, left empty.
+        pool(pool&& other) noexcept : blocks(std::move(other.blocks)) {
+            other.blocks.clear();
+        }
+
+        /// Release the own blocks and take over the blocks of another pool.
+        /// @param other The pool to move from, left empty.
+        pool& operator=(pool&& other) noexcept {
+            if (this != &other) {
+                release();
+                blocks = std::move(other.blocks);
+                other.blocks.clear();
+            }
+            return *this;
+        }
+
+        ~pool() {
+            release();
+        }
+
+        /// Make sure the next nodes can be created contiguously in a single block.
+        /// @param count The number of nodes about to be created.
+        void reserve(std::size_t count) {
+            if (blocks.empty() || blocks.back().size - blocks.back().used < count) {
+                grow(count > BlockSize ? count : BlockSize);
+            }
+        }
+
+        /// Create a node in the current block, starting a new block when it is full.
+        /// @param args The arguments forwarded to the node constructor.
+        /// @return The new node.
+        template <typename... Args>
+        U* create(Args&&... args) {
+            if (blocks.empty() || blocks.back().used == blocks.back().size) {
+                grow(BlockSize);
+            }
+            Block& block = blocks.back();
+            U* node = ::new (static_cast<void*>(block.slots + block.used)) U(std::forward<Args>(args)...);
+            ++block.used;
+            return node;
+        }
+
+        /// Nodes are reclaimed by release(), so destroying a single node does nothing.
+        void destroy(U*) {}
+
+        /// Destroy every node and free every block.
+        void release() {
+            for (Block& block : blocks) {
+                if (!std::is_trivially_destructible<U>::value) {
+                    for (std::size_t i = 0; i < block.used; ++i) {
+                        block.slots[i].~U();
+                    }
+                }
+                ::operator delete(block.slots);
+            }
+            blocks.clear();
+        }
+
+    private:
+        /// Start a new block.
+        /// @param size The number of slots in the block.
+        void grow(std::size_t size) {
+            Block block;
+            block.slots = static_cast<U*>(::operator new(size * sizeof(U)));
+            block.used = 0;
+            block.size = size;
+            try {
+                blocks.push_back(block);
+            } catch (...) {
+                ::operator delete(block.slots);
+                throw;
+            }
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef NODE_INDEX_HPP
+#define NODE_INDEX_HPP
+
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+
+/// Index policy that keeps no lookup table.
+/// Parent lookups in Tree::add_sub_node fall back to searching the tree.
+struct NoIndex {
+    /// The (empty) table stored inside the tree.
+    template <typename T, typename Ptr>
+    class table {
+    public:
+        static const bool enabled = false;
+
+        Ptr find(const T&) const { return nullptr; }
+        void insert(const T&, Ptr) {}
+        void erase(const T&, Ptr) {}
+        void clear() {}
+    };
+};
+
+/// Index policy that maps every value in the tree to its node through a hash table,
+/// so looking up a parent by value takes constant time.
+/// Every node has its own entry, so removing one node keeps the others holding the same value;
+/// when several nodes hold a value, any one of them may be found.
+/// The tree keys each node by its value when the node is inserted. Changing a value afterwards,
+/// through an iterator, a handle or a top_k() reference, leaves the old key behind until
+/// Tree::reindex() is called.
+/// @tparam Hash The hash function for T (std::hash<T> when left as void).
+template <typename Hash = void>
+struct HashIndex {
+    /// The hash table stored inside the tree.
+    template <typename T, typename Ptr>
+    class table {
+        typedef typename std::conditional<std::is_void<Hash>::value, std::hash<T>, Hash>::type hasher;
+        std::unordered_multimap<T, Ptr, hasher> nodes;
+    public:
+        static const bool enabled = true;
+
+        /// Find a node holding a value.
+        /// @param val The value to look up.
+        /// @return The node or nullptr if no node holds the value.
+        Ptr find(const T& val) const {
+            auto it = nodes.find(val);
+            return it == nodes.end() ? nullptr : it->second;
+        }
+
+        /// Register a node, next to any other nodes with the same value.
+        /// @param val The value held by the node.
+        /// @param node The node.
+        void insert(const T& val, Ptr node) {
+            nodes.insert(std::make_pair(val, node));
+        }
+
+        /// Remove the entry of a node, keeping other nodes with the same value.
+        /// @param val The value held by the node.
+        /// @param node The node.
+        void erase(const T& val, Ptr node) {
+            auto range = nodes.equal_range(val);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == node) {
+                    nodes.erase(it);
+                    return;
+                }
+            }
+        }
+
+        /// Remove every entry.
+        void clear() {
+            nodes.clear();
+        }
+    };
+};
+
+#endif
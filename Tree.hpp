@@ -2,84 +2,488 @@
 #define TREE_HPP
 
 #include "Node.hpp"
+#include "NodeIndex.hpp"
+#include "NodeAllocator.hpp"
+#include "ChildList.hpp"
+#include "FlatTree.hpp"
+#include "TreeLayout.hpp"
+#include "TreeExport.hpp"
+#include "TreeSnapshot.hpp"
 #include "Complex.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <iostream>
+#include <limits>
+#include <thread>
 #include <vector>
-#include <queue>
-#include <stack>
 #include <sstream>
-#include <QApplication>
-#include <QGraphicsScene>
-#include <QGraphicsView>
-#include <QGraphicsTextItem>
-#include <QGraphicsLineItem>
+#include <stdexcept>
+#include <string>
 
 using namespace std;
 
-/// A generic k-ary tree class with various traversal methods and GUI printing.
-template <typename T, int K = 2>
+/// How Tree::myHeap() orders the nodes.
+enum class HeapMode {
+    Sorted,         ///< Fully ascending level order.
+    Heapify,        ///< Min-heap property only, built in linear time.
+    ParallelSorted  ///< Fully ascending level order, sorted by several threads.
+};
+
+/// A generic k-ary tree class with various traversal methods and text, DOT and SVG output.
+/// The Qt viewer lives in TreeViewer.hpp, so this header needs nothing beyond the standard library.
+/// @tparam T The type of the values stored in the tree.
+/// @tparam K The maximum number of children of a node.
+/// @tparam Index The parent lookup policy: NoIndex searches the tree, HashIndex<> keeps a hash table
+///               (see reindex() for values changed in place).
+/// @tparam Alloc The node allocation policy: NewDeleteAlloc allocates nodes one by one, ArenaAlloc<> in blocks.
+template <typename T, int K = 2, typename Index = NoIndex, typename Alloc = NewDeleteAlloc>
 class Tree {
     struct TreeNode {
         Node<T> data;
-        std::vector<TreeNode*> children;
-        TreeNode(Node<T> val) : data(val) {}
+        ChildList<TreeNode*, K> children; ///< Inline for small K, a vector otherwise.
+        TreeNode* parent;                 ///< The parent node, nullptr for the root.
+        unsigned slot;                    ///< The position of the node among its parent's children.
+        template <typename... Args>
+        explicit TreeNode(Args&&... args) : data(std::forward<Args>(args)...), parent(nullptr), slot(0) {}
     };
 
+    typedef typename Index::template table<T, TreeNode*> IndexTable;
+    typedef typename Alloc::template pool<TreeNode> NodePool;
+
+    NodePool pool;    ///< Storage for the nodes.
     TreeNode* root;
+    IndexTable index; ///< Value to node lookup table.
+    bool heap_ordered; ///< Every node is no smaller than its parent, set by myHeap().
+    std::size_t node_count; ///< Number of nodes in the tree.
+    std::shared_ptr<SnapshotSource<T, K>> source; ///< Set once something follows the tree, see snapshot_source().
+
+    /// Marks a change of the tree for the viewers following it:
+    /// holds the snapshot mutex for the lifetime of the object and flags the change at the end.
+    class Change {
+        SnapshotSource<T, K>* source;
+    public:
+        explicit Change(const Tree& tree) : source(tree.source.get()) {
+            if (source) source->mutex.lock();
+        }
+        ~Change() {
+            if (source) {
+                source->changed = true;
+                source->mutex.unlock();
+            }
+        }
+        Change(const Change&) = delete;
+        Change& operator=(const Change&) = delete;
+    };
 
 public:
+    /// Opaque reference to a node of the tree, returned by the insertion methods.
+    /// A handle stays valid for as long as its node is part of the tree, and may only be passed back
+    /// to that tree: a handle from another tree would link the new node into the other tree while this
+    /// one owns its memory. Define TREE_CHECK_HANDLES to assert this on every use.
+    class NodeHandle {
+        TreeNode* node;
+        explicit NodeHandle(TreeNode* node) : node(node) {}
+        friend class Tree;
+    public:
+        /// Construct a null handle.
+        NodeHandle() : node(nullptr) {}
+
+        /// Check whether the handle refers to a node.
+        explicit operator bool() const { return node != nullptr; }
+
+        bool operator==(const NodeHandle& other) const { return node == other.node; }
+        bool operator!=(const NodeHandle& other) const { return node != other.node; }
+
+        Node<T>& operator*() const { return node->data; }
+        Node<T>* operator->() const { return &node->data; }
+
+        /// Get the number of children of the node.
+        /// @return The number of children.
+        std::size_t child_count() const { return node->children.size(); }
+
+        /// Get a child of the node.
+        /// @param i The position of the child, smaller than child_count().
+        /// @return A handle to the child.
+        NodeHandle child(std::size_t i) const { return NodeHandle(node->children[i]); }
+    };
+
     /// Constructor to initialize the tree with no root.
-    Tree() : root(nullptr) {}
+    Tree() : root(nullptr), heap_ordered(false), node_count(0) {}
+
+    /// Copy constructor, a deep copy of every node.
+    /// @param other The tree to copy.
+    Tree(const Tree& other) : root(nullptr), heap_ordered(false), node_count(0) {
+        copy_from(other, 1);
+    }
+
+    /// Move constructor, takes over the nodes of another tree in O(1).
+    /// @param other The tree to move from, left empty.
+    Tree(Tree&& other) noexcept : root(nullptr), heap_ordered(false), node_count(0) {
+        // A viewer following other may be taking a snapshot of it right now.
+        Change other_change(other);
+        pool = std::move(other.pool);
+        root = other.root;
+        index = std::move(other.index);
+        heap_ordered = other.heap_ordered;
+        node_count = other.node_count;
+        other.root = nullptr;
+        other.index.clear();
+        other.heap_ordered = false;
+        other.node_count = 0;
+    }
+
+    /// Copy assignment, replaces the nodes by a deep copy of another tree.
+    /// @param other The tree to copy.
+    /// @return This tree.
+    Tree& operator=(const Tree& other) {
+        if (this != &other) {
+            Tree copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    /// Move assignment, destroys the own nodes and takes over the nodes of another tree.
+    /// @param other The tree to move from, left empty.
+    /// @return This tree.
+    Tree& operator=(Tree&& other) noexcept {
+        if (this != &other) {
+            Change change(*this), other_change(other);
+            destroy_all();
+            pool = std::move(other.pool);
+            root = other.root;
+            index = std::move(other.index);
+            heap_ordered = other.heap_ordered;
+            node_count = other.node_count;
+            other.root = nullptr;
+            other.index.clear();
+            other.heap_ordered = false;
+            other.node_count = 0;
+        }
+        return *this;
+    }
 
     /// Destructor to clear the tree.
     ~Tree() {
-        clear(root);
+        if (source) {
+            // Viewers keep showing the last snapshot.
+            std::lock_guard<std::mutex> lock(source->mutex);
+            source->take = nullptr;
+            source->changed = true;
+        }
+        destroy_all();
+    }
+
+    /// Make a deep copy of the tree.
+    /// Storage for all nodes is reserved up front and every node is created in a single walk.
+    /// With several threads and a thread-safe allocator (NewDeleteAlloc), the top levels are copied
+    /// first and the subtrees below them are copied in parallel.
+    /// @param threads The number of threads to use.
+    /// @return The copy.
+    Tree clone(unsigned threads = 1) const {
+        Tree copy;
+        copy.copy_from(*this, threads);
+        return copy;
+    }
+
+    /// Save the tree to a binary file that FlatTree<T, K>::map_file() (FlatTreeFile.hpp) opens as a read-only view.
+    /// Only trivially copyable values, such as double or Complex, can be saved.
+    /// @param path The file to write.
+    /// @throws std::runtime_error if the file cannot be written.
+    void save(const std::string& path) const {
+        FlatTree<T, K>(*this).save(path);
+    }
+
+    /// Write the tree as text, one line per node in pre-order: "id parent value", where the ids
+    /// count the nodes from 0, the root has parent -1 and the value is written with operator<<.
+    /// The lines are streamed out as the tree is walked; besides the stream buffer only the ids
+    /// of the current ancestors are kept. Doubles are written with enough digits to read back exactly.
+    /// @param os The stream to write to.
+    void write_text(std::ostream& os) const {
+        std::streamsize precision = os.precision(std::numeric_limits<double>::max_digits10);
+        visit_with_ids([&os](const TreeNode* node, long long id, long long parent) {
+            os << id << ' ' << parent << ' ' << node->data.get_value() << '\n';
+        });
+        os.precision(precision);
+    }
+
+    /// Write the tree as a Graphviz DOT digraph, e.g. for "dot -Tsvg".
+    /// Node n<i> is the i-th node in pre-order. The nodes are written as the tree is walked,
+    /// so no value is copied.
+    /// @param os The stream to write to.
+    void write_dot(std::ostream& os) const {
+        LabelWriter labels;
+        os << dot_header();
+        visit_with_ids([&os, &labels](const TreeNode* node, long long id, long long parent) {
+            os << "  n" << id << " [label=\"" << labels.label(node->data, false) << "\"];\n";
+            if (parent >= 0) {
+                os << "  n" << parent << " -> n" << id << ";\n";
+            }
+        });
+        os << "}\n";
+    }
+
+    /// Lay out the tree and write it as an SVG image, without Qt.
+    /// The layout only needs the shape of the tree; the labels are read from the nodes themselves.
+    /// @param os The stream to write to.
+    /// @param node_gap The horizontal distance between neighbouring nodes, in pixels.
+    /// @param level_gap The vertical distance between levels, in pixels.
+    void write_svg(std::ostream& os, double node_gap = 80, double level_gap = 60) const {
+        Shape shape(root, node_count);
+        ::write_svg(os, shape, TreeLayout(shape, node_gap, level_gap));
+    }
+
+    /// Read a tree written by write_text().
+    /// The input is read line by line and every node must come after its parent in pre-order,
+    /// so only the chain of open ancestors is kept besides the tree itself. Any integer ids work.
+    /// Values are read with operator>>, except strings, which take the rest of the line
+    /// (so string values must not contain line breaks).
+    /// Empty lines are skipped.
+    /// @param is The stream to read from.
+    /// @return The tree.
+    /// @throws std::runtime_error if a line is malformed, a parent is not an ancestor of the
+    /// previous node, a parent already has K children or there is more than one root.
+    static Tree read_text(std::istream& is) {
+        struct Open {
+            long long id;
+            TreeNode* node;
+        };
+        Tree tree;
+        std::vector<Open> ancestors; // the last node read and its ancestors, root first
+        std::string line;
+        std::istringstream fields;
+        T value = T();
+        for (std::size_t number = 1; std::getline(is, line); ++number) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            fields.clear();
+            fields.str(line);
+            long long id, parent;
+            if (!(fields >> id >> parent) || !read_value(fields, value)) {
+                throw text_error(number, "expected \"id parent value\"");
+            }
+            TreeNode* node;
+            if (parent < 0) {
+                if (tree.root) {
+                    throw text_error(number, "the tree has a second root");
+                }
+                node = tree.root = tree.pool.create(std::move(value));
+                ++tree.node_count;
+                tree.index.insert(node->data.get_value(), node);
+            } else {
+                while (!ancestors.empty() && ancestors.back().id != parent) {
+                    ancestors.pop_back();
+                }
+                if (ancestors.empty()) {
+                    throw text_error(number, "the parent is not an ancestor of the previous node");
+                }
+                NodeHandle child = tree.attach(ancestors.back().node, std::move(value));
+                if (!child) {
+                    throw text_error(number, "the parent already has K children");
+                }
+                node = child.node;
+            }
+            ancestors.push_back(Open{id, node});
+        }
+        return tree;
+    }
+
+    /// Build a complete tree from values listed level by level, left to right:
+    /// the children of the i-th value are the values K*i+1 to K*i+K.
+    /// All nodes are created in one pass, contiguously when the tree uses ArenaAlloc.
+    /// @param first The first value.
+    /// @param last One past the last value.
+    /// @return The tree.
+    template <typename ForwardIt>
+    static Tree from_level_order(ForwardIt first, ForwardIt last) {
+        Tree tree;
+        size_t count = static_cast<size_t>(std::distance(first, last));
+        if (count == 0) return tree;
+        tree.pool.reserve(count);
+        std::vector<TreeNode*> nodes;
+        nodes.reserve(count);
+        for (; first != last; ++first) {
+            TreeNode* node = tree.pool.create(*first);
+            if (nodes.empty()) {
+                tree.root = node;
+            } else {
+                link(nodes[(nodes.size() - 1) / K], node);
+            }
+            nodes.push_back(node);
+            tree.index.insert(node->data.get_value(), node);
+        }
+        tree.node_count = count;
+        return tree;
+    }
+
+    /// Build a tree from a parent array: the parent of values[i] is values[parents[i]],
+    /// and the one node with a negative parent is the root.
+    /// Children keep the order of their indices. All nodes are created in one pass,
+    /// contiguously when the tree uses ArenaAlloc.
+    /// @param values The node values.
+    /// @param parents The parent index of each node, negative for the root.
+    /// @return The tree.
+    /// @throws std::invalid_argument if the arrays do not describe a tree with at most K children per node.
+    static Tree from_parent_array(const std::vector<T>& values, const std::vector<long>& parents) {
+        Tree tree;
+        size_t count = values.size();
+        if (parents.size() != count) {
+            throw std::invalid_argument("from_parent_array: values and parents differ in size");
+        }
+        if (count == 0) return tree;
+
+        size_t roots = 0;
+        std::vector<unsigned> children(count, 0);
+        for (size_t i = 0; i < count; ++i) {
+            if (parents[i] < 0) {
+                ++roots;
+            } else if (static_cast<size_t>(parents[i]) >= count) {
+                throw std::invalid_argument("from_parent_array: parent index out of range");
+            } else if (++children[parents[i]] > static_cast<unsigned>(K)) {
+                throw std::invalid_argument("from_parent_array: a node has more than K children");
+            }
+        }
+        if (roots != 1) {
+            throw std::invalid_argument("from_parent_array: there must be exactly one root");
+        }
+
+        // The nodes are only linked once all exist, so until then the tree cannot free them itself.
+        std::vector<TreeNode*> nodes;
+        auto discard = [&tree, &nodes]() {
+            for (TreeNode* node : nodes) {
+                tree.pool.destroy(node);
+            }
+            tree.pool.release();
+            tree.root = nullptr;
+        };
+        try {
+            tree.pool.reserve(count);
+            nodes.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                nodes.push_back(tree.pool.create(values[i]));
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (parents[i] < 0) {
+                    tree.root = nodes[i];
+                } else {
+                    link(nodes[parents[i]], nodes[i]);
+                }
+            }
+        } catch (...) {
+            discard();
+            throw;
+        }
+
+        // With one root and in-range parents, only a cycle can leave nodes unreachable.
+        size_t reachable = 0;
+        for (TreeNode* node = tree.root; node; node = next_pre_order(node)) {
+            ++reachable;
+        }
+        if (reachable != count) {
+            discard();
+            throw std::invalid_argument("from_parent_array: the parent links contain a cycle");
+        }
+
+        for (TreeNode* node : nodes) {
+            tree.index.insert(node->data.get_value(), node);
+        }
+        tree.node_count = count;
+        return tree;
+    }
+
+    /// Get the number of nodes.
+    /// @return The number of nodes in the tree.
+    std::size_t size() const {
+        return node_count;
+    }
+
+    /// Check whether the tree has no nodes.
+    /// @return True if the tree has no root.
+    bool empty() const {
+        return root == nullptr;
+    }
+
+    /// Get the root node.
+    /// @return A handle to the root node, or a null handle if the tree is empty.
+    NodeHandle root_handle() const {
+        return NodeHandle(root);
     }
 
     /// Add or replace the root node.
     /// @param val The value of the root node.
-    void add_root(Node<T> val) {
-        if (root) {
-            root->data = val;
-        } else {
-            root = new TreeNode(val);
-        }
+    /// @return A handle to the root node.
+    NodeHandle add_root(Node<T> val) {
+        return replace_root(std::move(val));
+    }
+
+    /// Add or replace the root node, constructing its value in place.
+    /// @param args The arguments forwarded to the constructor of T.
+    /// @return A handle to the root node.
+    template <typename... Args>
+    NodeHandle emplace_root(Args&&... args) {
+        return replace_root(InPlace(), std::forward<Args>(args)...);
     }
 
     /// Add a child node to a specified parent node.
+    /// The parent is found through the index when the tree keeps one, otherwise by searching the tree.
     /// @param parent_val The value of the parent node.
     /// @param child_val The value of the child node.
-    void add_sub_node(Node<T> parent_val, Node<T> child_val) {
-        TreeNode* parent = find(root, parent_val);
-        if (parent && parent->children.size() < K) {
-            parent->children.push_back(new TreeNode(child_val));
-        }
+    /// @return A handle to the new node, or a null handle if the parent was not found or is full.
+    NodeHandle add_sub_node(Node<T> parent_val, Node<T> child_val) {
+        return attach(lookup(parent_val), std::move(child_val));
+    }
+
+    /// Add a child node to a parent given by handle, without searching for the parent.
+    /// @param parent The handle of the parent node, from this tree.
+    /// @param child_val The value of the child node.
+    /// @return A handle to the new node, or a null handle if the parent is null or full.
+    NodeHandle add_sub_node(NodeHandle parent, Node<T> child_val) {
+        check_handle(parent);
+        return attach(parent.node, std::move(child_val));
+    }
+
+    /// Add a child node to a parent given by handle, constructing its value in place.
+    /// @param parent The handle of the parent node, from this tree.
+    /// @param args The arguments forwarded to the constructor of T.
+    /// @return A handle to the new node, or a null handle if the parent is null or full.
+    template <typename... Args>
+    NodeHandle emplace_child(NodeHandle parent, Args&&... args) {
+        check_handle(parent);
+        return attach(parent.node, InPlace(), std::forward<Args>(args)...);
+    }
+
+    /// Add a child node to a specified parent node, constructing its value in place.
+    /// @param parent_val The value of the parent node.
+    /// @param args The arguments forwarded to the constructor of T.
+    /// @return A handle to the new node, or a null handle if the parent was not found or is full.
+    template <typename... Args>
+    NodeHandle emplace_child(const Node<T>& parent_val, Args&&... args) {
+        return attach(lookup(parent_val), InPlace(), std::forward<Args>(args)...);
     }
 
     /// Pre-order traversal iterator. dfs output = pre_order output here
+    /// Walks the tree through parent links, so it never allocates and is cheap to copy.
     class PreOrderIterator {
-        std::stack<TreeNode*> nodes;
+        TreeNode* current;
     public:
-        PreOrderIterator(TreeNode* root) {
-            if (root) nodes.push(root);
-        }
+        PreOrderIterator(TreeNode* root) : current(root) {}
 
-        // using this only to check inequality with the PreOrderIterator(nullptr)
         bool operator!=(const PreOrderIterator& other) const {
-            (void)other; // Explicitly mark as unused
-            return !nodes.empty();
+            return current != other.current;
         }
 
         Node<T>& operator*() const {
-            return nodes.top()->data;
+            return current->data;
         }
 
         PreOrderIterator& operator++() {
-            TreeNode* node = nodes.top();
-            nodes.pop();
-            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
-                nodes.push(*it);
-            }
+            current = next_pre_order(current);
             return *this;
         }
     };
@@ -97,54 +501,31 @@ public:
     }
 
     /// Post-order traversal iterator. run dfs if non binary
+    /// Streams the nodes through parent links: the first node is found by following first children
+    /// down to a leaf, and every step moves to the leftmost leaf of the next sibling or up to the parent.
+    /// Nothing is precomputed, so stopping early costs only the nodes visited.
     class PostOrderIterator {
-        std::stack<TreeNode*> nodes;
-        std::stack<TreeNode*> output;
+        TreeNode* current;
     public:
-        PostOrderIterator(TreeNode* root) {
-            if(K==2){
-                if (root) {
-                    nodes.push(root);
-                    while (!nodes.empty()) {
-                        TreeNode* node = nodes.top();
-                        nodes.pop();
-                        output.push(node);
-                        for (auto child : node->children) {
-                            nodes.push(child);
-                        }
-                    }
-                }
-            } else{
-                if (root) nodes.push(root);
+        PostOrderIterator(TreeNode* root) : current(root) {
+            if(K==2 && current){
+                current = leftmost_leaf(current);
             }
         }
-        // using this only to check inequality with the PreOrderIterator(nullptr)
+
         bool operator!=(const PostOrderIterator& other) const {
-            (void)other; // Explicitly mark as unused
-            if(K==2){
-            return !output.empty();
-            } else {
-                return !nodes.empty();
-            }
+            return current != other.current;
         }
 
         Node<T>& operator*() const {
-            if(K==2){
-                return output.top()->data;
-            } else {
-                return nodes.top()->data;
-            }
+            return current->data;
         }
 
         PostOrderIterator& operator++() {
             if(K==2){
-                output.pop();
+                current = next_post_order(current);
             }else{
-                TreeNode* node = nodes.top();
-                nodes.pop();
-                for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
-                nodes.push(*it);
-                }
+                current = next_pre_order(current);
             }
             return *this;
         }
@@ -163,61 +544,29 @@ public:
     }
 
     /// In-order traversal iterator. run dsf if non binary
+    /// Walks the tree through parent links, so it never allocates and is cheap to copy.
     class InOrderIterator {
-        std::stack<TreeNode*> nodes;
         TreeNode* current;
     public:
         InOrderIterator(TreeNode* root) : current(root) {
-            if(K==2){
-                while (current && !current->children.empty()) {
-                    nodes.push(current);
-                    current = current->children.front();
-                }
-            } else{
-                if (root) nodes.push(root);
+            if(K==2 && current){
+                current = leftmost_leaf(current);
             }
         }
 
-        // using this only to check inequality with the PreOrderIterator(nullptr)
         bool operator!=(const InOrderIterator& other) const {
-            (void)other; // Explicitly mark as unused
-            if(K ==2){
-                return current != nullptr;
-            } else{
-                return !nodes.empty();
-            }
+            return current != other.current;
         }
 
         Node<T>& operator*() const {
-            if(K==2){
-                return current->data;
-            } else {
-                return nodes.top()->data;
-            }
+            return current->data;
         }
 
         InOrderIterator& operator++() {
             if(K==2){
-                if (current->children.size() > 1) {
-                    current = current->children[1];
-                    while (current && !current->children.empty()) {
-                        nodes.push(current);
-                        current = current->children.front();
-                    }
-                } else {
-                    if (nodes.empty()) {
-                        current = nullptr;
-                    } else {
-                        current = nodes.top();
-                        nodes.pop();
-                    }
-                }
+                current = next_in_order(current);
             }else{
-                TreeNode* node = nodes.top();
-                nodes.pop();
-                for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
-                nodes.push(*it);
-                }
+                current = next_pre_order(current);
             }
             return *this;
         }
@@ -235,29 +584,50 @@ public:
         return InOrderIterator(nullptr);
     }
 
+    /// Reusable storage for BFS traversals, see begin_bfs_scan(BFSBuffer&).
+    class BFSBuffer {
+        std::vector<TreeNode*> queue;
+        friend class Tree;
+    };
+
     /// BFS traversal iterator.
+    /// The nodes still to visit wait in a vector used as a FIFO; its visited front is dropped once it
+    /// makes up half of the vector, so a full scan is O(N) and keeps about one level of pointers.
+    /// The default iterator owns its queue, so copies are independent positions in the walk.
+    /// An iterator from begin_bfs_scan(BFSBuffer&) queues in the caller's buffer instead and does not
+    /// allocate once the buffer has grown; its copies share that queue, so only one may be advanced.
     class BFSIterator {
-        std::queue<TreeNode*> nodes;
+        std::vector<TreeNode*> own;     ///< The queue, unless the caller supplied a buffer.
+        std::vector<TreeNode*>* shared; ///< The caller's queue, or nullptr.
+        std::size_t head;               ///< Position of the next node to visit in the queue.
+        TreeNode* current;
     public:
-        BFSIterator(TreeNode* root) {
-            if (root) nodes.push(root);
+        BFSIterator(TreeNode* root, std::vector<TreeNode*>* shared = nullptr)
+            : shared(shared), head(0), current(root) {
+            if (shared) shared->clear();
         }
 
-        // using this only to check inequality with the PreOrderIterator(nullptr)
         bool operator!=(const BFSIterator& other) const {
-            (void)other; // Explicitly mark as unused
-            return !nodes.empty();
+            return current != other.current;
         }
 
         Node<T>& operator*() const {
-            return nodes.front()->data;
+            return current->data;
         }
 
         BFSIterator& operator++() {
-            TreeNode* node = nodes.front();
-            nodes.pop();
-            for (auto child : node->children) {
-                nodes.push(child);
+            std::vector<TreeNode*>& queue = shared ? *shared : own;
+            for (TreeNode* child : current->children) {
+                queue.push_back(child);
+            }
+            if (head == queue.size()) {
+                current = nullptr;
+                return *this;
+            }
+            current = queue[head++];
+            if (head >= 64 && 2 * head >= queue.size()) {
+                queue.erase(queue.begin(), queue.begin() + head);
+                head = 0;
             }
             return *this;
         }
@@ -269,6 +639,14 @@ public:
         return BFSIterator(root);
     }
 
+    /// Begin BFS traversal queueing in a caller-supplied buffer, which keeps its capacity between
+    /// traversals, so repeated scans do not allocate.
+    /// @param buffer The buffer, in use until the traversal ends.
+    /// @return BFSIterator at the start.
+    BFSIterator begin_bfs_scan(BFSBuffer& buffer) {
+        return BFSIterator(root, &buffer.queue);
+    }
+
     /// End BFS traversal.
     /// @return BFSIterator at the end.
     BFSIterator end_bfs_scan() {
@@ -288,29 +666,22 @@ public:
     }
 
     /// DFS traversal iterator.
+    /// Walks the tree through parent links, so it never allocates and is cheap to copy.
     class DFSIterator {
-        std::stack<TreeNode*> nodes;
+        TreeNode* current;
     public:
-        DFSIterator(TreeNode* root) {
-            if (root) nodes.push(root);
-        }
+        DFSIterator(TreeNode* root) : current(root) {}
 
-        // using this only to check inequality with the PreOrderIterator(nullptr)
         bool operator!=(const DFSIterator& other) const {
-            (void)other; // Explicitly mark as unused
-            return !nodes.empty();
+            return current != other.current;
         }
 
         Node<T>& operator*() const {
-            return nodes.top()->data;
+            return current->data;
         }
 
         DFSIterator& operator++() {
-            TreeNode* node = nodes.top();
-            nodes.pop();
-            for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) {
-                nodes.push(*it);
-            }
+            current = next_pre_order(current);
             return *this;
         }
     };
@@ -327,51 +698,61 @@ public:
         return DFSIterator(nullptr);
     }
 
-    /// Heap traversal iterator.
+    /// Heap traversal iterator, visiting the values in ascending order.
+    /// Nodes are popped lazily from a min-heap of node pointers, so no value is copied and reading
+    /// the first m values costs O(N + m log N). After myHeap() the tree is itself a min-heap and the
+    /// iterator only keeps the frontier of visited nodes' children, making the first m values cost O(m log m).
+    /// Changing values through an iterator after myHeap() voids that ordering.
     class HeapIterator {
-        std::vector<Node<T>> heap;
-        size_t index;
+        std::vector<TreeNode*> heap; ///< Pending nodes, smallest value on top.
+        bool frontier;               ///< The tree is heap ordered and heap holds only the frontier.
+
+        /// Order nodes so that the smallest value is on top of the heap.
+        static bool greater(TreeNode* a, TreeNode* b) {
+            return b->data < a->data;
+        }
     public:
-        HeapIterator(TreeNode* root) : index(0) {
+        HeapIterator(TreeNode* root, bool heap_ordered = false) : frontier(heap_ordered) {
             if (root) {
-                toHeap(root);
-                // std::greater<Node<T>>: A comparison function that ensures a min-heap is created.
-                std::make_heap(heap.begin(), heap.end(), std::less<Node<T>>()); // organize the elements in the heap vector into a heap structure
-                std::sort_heap(heap.begin(), heap.end(), std::less<Node<T>>()); // To sort the elements of the heap in ascending order.
+                if (frontier) {
+                    heap.push_back(root);
+                } else {
+                    for (TreeNode* node = root; node; node = next_pre_order(node)) {
+                        heap.push_back(node);
+                    }
+                    std::make_heap(heap.begin(), heap.end(), greater);
+                }
             }
         }
 
-        // using this only to check inequality with the PreOrderIterator(nullptr)
+        // using this only to check inequality with the HeapIterator(nullptr)
         bool operator!=(const HeapIterator& other) const {
             (void)other; // Explicitly mark as unused
-            return index != heap.size();
+            return !heap.empty();
         }
 
-        Node<T>& operator*() {
-            return heap[index];
+        Node<T>& operator*() const {
+            return heap.front()->data;
         }
 
         HeapIterator& operator++() {
-            ++index;
-            return *this;
-        }
-
-        /// Convert the tree to a heap.
-        /// @param node The root node of the subtree to convert.
-        void toHeap(TreeNode* node) {
-            if (node) {
-                heap.push_back(node->data);
-                for (auto child : node->children) {
-                    toHeap(child);
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            TreeNode* node = heap.back();
+            heap.pop_back();
+            if (frontier) {
+                for (TreeNode* child : node->children) {
+                    heap.push_back(child);
+                    std::push_heap(heap.begin(), heap.end(), greater);
                 }
             }
+            return *this;
         }
     };
 
     /// Begin heap traversal.
     /// @return HeapIterator at the start.
     HeapIterator begin_heap() {
-        return HeapIterator(root);
+        return HeapIterator(root, heap_ordered);
     }
 
     /// End heap traversal.
@@ -380,20 +761,101 @@ public:
         return HeapIterator(nullptr);
     }
 
+    /// Get the k first values of the tree in the order of a comparator.
+    /// A single thread keeps a bounded heap of k node pointers while walking the tree, O(N log k).
+    /// With several threads the node pointers are split into chunks, each thread picks the best k
+    /// of its chunk in place, and the best k of those candidates are returned.
+    /// @param k The number of values to return.
+    /// @param comp The strict weak ordering on Node<T>; the result is sorted by it.
+    /// @param threads The number of threads to use.
+    /// @return References to the nodes holding the k first values, or to all nodes if the tree is smaller.
+    template <typename Compare>
+    std::vector<std::reference_wrapper<Node<T>>> top_k(std::size_t k, Compare comp, unsigned threads = 1) {
+        std::vector<std::reference_wrapper<Node<T>>> result;
+        if (!root || k == 0) return result;
+
+        auto before = [&comp](TreeNode* a, TreeNode* b) { return comp(a->data, b->data); };
+        std::vector<TreeNode*> best;
+        if (threads > 1) {
+            std::vector<TreeNode*> nodes;
+            for (TreeNode* node = root; node; node = next_pre_order(node)) {
+                nodes.push_back(node);
+            }
+            size_t chunk = (nodes.size() + threads - 1) / threads;
+            std::vector<std::thread> workers;
+            for (size_t first = 0; first < nodes.size(); first += chunk) {
+                size_t last = std::min(first + chunk, nodes.size());
+                workers.push_back(std::thread([&nodes, &before, first, last, k]() {
+                    size_t middle = first + std::min(k, last - first);
+                    std::partial_sort(nodes.begin() + first, nodes.begin() + middle, nodes.begin() + last, before);
+                }));
+            }
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+            for (size_t first = 0; first < nodes.size(); first += chunk) {
+                size_t count = std::min(k, std::min(chunk, nodes.size() - first));
+                best.insert(best.end(), nodes.begin() + first, nodes.begin() + first + count);
+            }
+            if (best.size() > k) {
+                std::nth_element(best.begin(), best.begin() + k, best.end(), before);
+                best.resize(k);
+            }
+        } else {
+            // Max-heap by comp: the worst of the k best so far is on top.
+            for (TreeNode* node = root; node; node = next_pre_order(node)) {
+                if (best.size() < k) {
+                    best.push_back(node);
+                    std::push_heap(best.begin(), best.end(), before);
+                } else if (before(node, best.front())) {
+                    std::pop_heap(best.begin(), best.end(), before);
+                    best.back() = node;
+                    std::push_heap(best.begin(), best.end(), before);
+                }
+            }
+        }
+        std::sort(best.begin(), best.end(), before);
+
+        result.reserve(best.size());
+        for (TreeNode* node : best) {
+            result.push_back(std::ref(node->data));
+        }
+        return result;
+    }
+
+    /// Get the k smallest values of the tree in ascending order.
+    /// @param k The number of values to return.
+    /// @param threads The number of threads to use.
+    /// @return References to the nodes holding the k smallest values.
+    std::vector<std::reference_wrapper<Node<T>>> smallest_k(std::size_t k, unsigned threads = 1) {
+        return top_k(k, std::less<Node<T>>(), threads);
+    }
+
+    /// Get the k largest values of the tree in descending order.
+    /// @param k The number of values to return.
+    /// @param threads The number of threads to use.
+    /// @return References to the nodes holding the k largest values.
+    std::vector<std::reference_wrapper<Node<T>>> largest_k(std::size_t k, unsigned threads = 1) {
+        return top_k(k, [](const Node<T>& a, const Node<T>& b) { return b < a; }, threads);
+    }
+
     /// Convert the tree to a vector of nodes.
     /// @param node The root node of the subtree to convert.
     /// @param nodes The vector to store the nodes.
     void toHeapVector(TreeNode* node, std::vector<TreeNode*>& nodes) {
-        if (node) {
-            nodes.push_back(node);
-            for (auto child : node->children) {
-                toHeapVector(child, nodes);
-            }
+        for (TreeNode* current = node; current; current = next_pre_order(current, node)) {
+            nodes.push_back(current);
         }
     }
 
     /// Convert a binary tree into a heap structure.
-    void myHeap() {
+    /// Values stay in their nodes, only the links change, so the index remains valid.
+    /// @param mode HeapMode::Sorted sorts the nodes so the level order is fully ascending (O(N log N)),
+    ///             HeapMode::Heapify only establishes the min-heap property in place (O(N)),
+    ///             HeapMode::ParallelSorted produces the same order as Sorted using several threads.
+    /// @param threads The number of threads used by HeapMode::ParallelSorted.
+    void myHeap(HeapMode mode = HeapMode::Sorted, unsigned threads = std::thread::hardware_concurrency()) {
+        Change change(*this);
         if(K==2){
             // If the tree is empty, return immediately.
             if (!root) return;
@@ -403,177 +865,522 @@ public:
             // Populate the vector with nodes from the tree.
             toHeapVector(root, nodes);
 
-            // Sort the nodes in ascending order based on their values.
-            std::sort(nodes.begin(), nodes.end(), [](TreeNode* a, TreeNode* b) {
+            auto less = [](TreeNode* a, TreeNode* b) {
                 return a->data < b->data;
-            });
+            };
+            if (mode == HeapMode::Heapify) {
+                // make_heap builds a max-heap, so reverse the comparison to get the smallest value on top.
+                std::make_heap(nodes.begin(), nodes.end(), [](TreeNode* a, TreeNode* b) {
+                    return b->data < a->data;
+                });
+            } else if (mode == HeapMode::ParallelSorted && threads > 1) {
+                parallel_sort(nodes, less, threads);
+            } else {
+                // Sort the nodes in ascending order based on their values.
+                std::sort(nodes.begin(), nodes.end(), less);
+            }
 
-            // Clear the children of each node and reassign them according to heap order.
+            // Reassign the children of each node according to heap order.
+            // The child lists are inline for K == 2, so this does not allocate.
             for (size_t i = 0; i < nodes.size(); ++i) {
                 nodes[i]->children.clear();
                 if (2 * i + 1 < nodes.size()) {
-                    nodes[i]->children.push_back(nodes[2 * i + 1]);
+                    link(nodes[i], nodes[2 * i + 1]);
                 }
                 if (2 * i + 2 < nodes.size()) {
-                    nodes[i]->children.push_back(nodes[2 * i + 2]);
+                    link(nodes[i], nodes[2 * i + 2]);
                 }
             }
 
-            // Set the first element of the sorted vector as the new root of the tree.
+            // Set the first element of the heap as the new root of the tree.
             root = nodes[0];
+            root->parent = nullptr;
+            root->slot = 0;
+            heap_ordered = true;
         }else{
             cout<< "tree is not binary"<< endl;
         }
     }
     
-    /// Print the tree using a GUI.
+    /// Print the tree as bracketed text: every node is followed by its children in square brackets,
+    /// e.g. "1.1[1.2[1.4, 1.5], 1.3[1.6]]", and an empty tree prints as "[]".
+    /// The values go straight into the stream buffer with operator<<, so no string is built per node.
+    /// Use printTreeGUI() or show_async() from TreeViewer.hpp to see the tree in a window.
     /// @param os The output stream to print to.
     /// @param tree The tree to print.
+    /// @return The output stream.
     friend std::ostream& operator<<(std::ostream& os, const Tree& tree) {
-        tree.printTreeGUI();
+        TreeNode* node = tree.root;
+        if (!node) {
+            return os << "[]";
+        }
+        while (node) {
+            os << node->data.get_value();
+            if (!node->children.empty()) {
+                os << '[';
+                node = node->children.front();
+                continue;
+            }
+            // Close the brackets of every subtree finished here.
+            while (node) {
+                TreeNode* sibling = next_sibling(node);
+                if (sibling) {
+                    os << ", ";
+                    node = sibling;
+                    break;
+                }
+                node = node->parent;
+                if (node) {
+                    os << ']';
+                }
+            }
+        }
         return os;
     }
 
-    /// Print the tree in a graphical user interface.
-    void printTreeGUI() const {
-        // Create the scene
-        QGraphicsScene scene;
+    /// Change the value of a node while keeping the index and any following viewer in step:
+    /// the node is re-keyed in the index and the change holds the snapshot mutex.
+    /// @param node The handle of the node, from this tree.
+    /// @param val The new value.
+    void set_value(NodeHandle node, T val) {
+        check_handle(node);
+        Change change(*this);
+        index.erase(node.node->data.get_value(), node.node);
+        node.node->data.set_value(std::move(val));
+        index.insert(node.node->data.get_value(), node.node);
+        heap_ordered = false;
+    }
 
-        // Start drawing the tree from the top middle of the screen
-        int startX = 750; // Adjust this based on your screen width
-        int startY = 50;  // Start slightly from the top for better visibility
-        int hGap = 200 * (K - 1); // Horizontal gap between nodes
-        int vGap = 100; // Vertical gap between levels
+    /// Rebuild the value index from the current values. The index keys every node by the value it
+    /// had when it was inserted, so call this after changing values through iterators, handles or
+    /// top_k() references; Tree::set_value() keeps it up to date by itself. Does nothing for NoIndex.
+    void reindex() {
+        if (!IndexTable::enabled) return;
+        index.clear();
+        for (TreeNode* node = root; node; node = next_pre_order(node)) {
+            index.insert(node->data.get_value(), node);
+        }
+    }
 
-        drawNode(scene, root, startX, startY, hGap, vGap);
+    /// Get the source of snapshots for following the tree from another thread, e.g. by show_async()
+    /// in TreeViewer.hpp. From the first call on, insertions, set_value(), myHeap() and move assignment
+    /// hold the source mutex while they run and flag the change. Writing to values through iterators,
+    /// handles or top_k() references bypasses the mutex and races with a snapshot being copied, so
+    /// while anything follows the tree change values with set_value() only.
+    /// The source stays with this tree object and stops at its destruction.
+    /// @return The snapshot source.
+    std::shared_ptr<SnapshotSource<T, K>> snapshot_source() {
+        if (!source) {
+            std::shared_ptr<SnapshotSource<T, K>> created = std::make_shared<SnapshotSource<T, K>>();
+            created->take = [this]() { return FlatTree<T, K>(*this); };
+            source = created;
+        }
+        return source;
+    }
+private:
+    /// Assert that a handle is null or refers to a node of this tree, if TREE_CHECK_HANDLES is defined.
+    /// The check walks up to the root in O(depth), so it is off by default, even without NDEBUG.
+    /// @param handle The handle.
+    void check_handle(const NodeHandle& handle) const {
+#ifdef TREE_CHECK_HANDLES
+        TreeNode* node = handle.node;
+        while (node && node->parent) {
+            node = node->parent;
+        }
+        assert(!node || node == root);
+#else
+        (void)handle;
+#endif
+    }
 
-        // Create a view to visualize the scene
-        QGraphicsView view(&scene);
-        // Enable antialiasing for smoother rendering of graphics.
-        view.setRenderHint(QPainter::Antialiasing);
+    /// Find the parent for an insertion by value.
+    /// @param parent_val The value of the parent node.
+    /// @return The node, through the index when the tree keeps one, or nullptr.
+    TreeNode* lookup(const Node<T>& parent_val) {
+        return IndexTable::enabled ? index.find(parent_val.get_value()) : find(root, parent_val);
+    }
 
-        // Set the viewport update mode to optimize performance for larger scenes.
-        view.setViewportUpdateMode(QGraphicsView::BoundingRectViewportUpdate);
+    /// Create the root node or replace its value.
+    /// @param args The arguments forwarded to the constructor of Node<T>.
+    /// @return A handle to the root node.
+    template <typename... Args>
+    NodeHandle replace_root(Args&&... args) {
+        Change change(*this);
+        if (root) {
+            index.erase(root->data.get_value(), root);
+            root->data = Node<T>(std::forward<Args>(args)...);
+            heap_ordered = false;
+        } else {
+            root = pool.create(std::forward<Args>(args)...);
+            ++node_count;
+        }
+        index.insert(root->data.get_value(), root);
+        return NodeHandle(root);
+    }
 
-        // Set a gradient background for a more professional look.
-        QLinearGradient gradient(0, 0, 0, 800);
-        gradient.setColorAt(0, QColor(60, 60, 60)); // Darker gray at the top.
-        gradient.setColorAt(1, QColor(30, 30, 30)); // Even darker gray at the bottom.
-        view.setBackgroundBrush(gradient);
+    /// The links of the tree as BFS index arrays, like a FlatTree without the values,
+    /// which stay in the nodes. Used to lay out a tree without copying any value.
+    class Shape {
+        std::vector<const TreeNode*> nodes;
+        std::vector<std::uint32_t> parents, first_children, child_counts;
+    public:
+        static const std::uint32_t npos = 0xFFFFFFFFu;
 
-        // Set the window title for the graphics view.
-        view.setWindowTitle("Tree Visualization");
+        /// Number the nodes below a root in BFS order.
+        /// @param root The root, may be nullptr.
+        /// @param count The number of nodes.
+        Shape(const TreeNode* root, std::size_t count) {
+            if (!root) return;
+            nodes.reserve(count);
+            parents.reserve(count);
+            first_children.reserve(count);
+            child_counts.reserve(count);
+            nodes.push_back(root);
+            parents.push_back(npos);
+            for (std::size_t i = 0; i < nodes.size(); ++i) {
+                first_children.push_back(static_cast<std::uint32_t>(nodes.size()));
+                child_counts.push_back(static_cast<std::uint32_t>(nodes[i]->children.size()));
+                for (const TreeNode* child : nodes[i]->children) {
+                    nodes.push_back(child);
+                    parents.push_back(static_cast<std::uint32_t>(i));
+                }
+            }
+        }
 
-        // Define the fixed size of the view window.
-        view.setFixedSize(1600, 900);
-        scene.setSceneRect(0, 0, 1500, 800); // Set the scene's rectangle size to match the view.
+        std::size_t size() const { return nodes.size(); }
+        const Node<T>& value(std::uint32_t i) const { return nodes[i]->data; }
+        std::uint32_t parent(std::uint32_t i) const { return parents[i]; }
+        std::uint32_t first_child(std::uint32_t i) const { return first_children[i]; }
+        std::uint32_t child_count(std::uint32_t i) const { return child_counts[i]; }
+    };
 
-        // Display the view.
-        view.show();
+    /// Walk the tree in pre-order, numbering the nodes from 0 in that order.
+    /// Only the ids of the current ancestors are kept besides the walk.
+    /// @param visit Called with each node, its id and the id of its parent, -1 for the root.
+    template <typename Visit>
+    void visit_with_ids(Visit visit) const {
+        std::vector<long long> ancestors; // ids of the ancestors of node, root first
+        long long id = 0;
+        TreeNode* node = root;
+        while (node) {
+            visit(node, id, ancestors.empty() ? -1 : ancestors.back());
+            if (!node->children.empty()) {
+                ancestors.push_back(id++);
+                node = node->children.front();
+                continue;
+            }
+            ++id;
+            // Climb to the nearest ancestor with a next sibling.
+            while (node) {
+                TreeNode* sibling = next_sibling(node);
+                if (sibling) {
+                    node = sibling;
+                    break;
+                }
+                node = node->parent;
+                if (node) {
+                    ancestors.pop_back();
+                }
+            }
+        }
+    }
 
-        // Start the Qt event loop to handle user interaction and updates.
-        QApplication::exec();
+    /// Read a value from the fields of a text line.
+    /// @param in The fields following the ids.
+    /// @param value Receives the value.
+    /// @return True if a value was read.
+    template <typename U>
+    static bool read_value(std::istream& in, U& value) {
+        return static_cast<bool>(in >> value);
     }
-private:
-    /// Clear the tree recursively.
-    /// @param node The node to clear.
-    void clear(TreeNode* node) {
-        if (node) {
-            for (auto child : node->children) {
-                clear(child);
+
+    /// Read a string value: the rest of the line after the separating space, possibly empty.
+    static bool read_value(std::istream& in, std::string& value) {
+        value.clear();
+        if (in.get() == ' ') {
+            std::getline(in, value);
+        }
+        return true;
+    }
+
+    /// Build the exception for a malformed line of text input.
+    /// @param number The line number, starting at 1.
+    /// @param what What is wrong with the line.
+    /// @return The exception.
+    static std::runtime_error text_error(std::size_t number, const char* what) {
+        std::ostringstream message;
+        message << "read_text: line " << number << ": " << what;
+        return std::runtime_error(message.str());
+    }
+
+    /// Append a new child to a parent node.
+    /// @param parent The parent node, may be nullptr.
+    /// @param args The arguments forwarded to the constructor of Node<T>.
+    /// @return A handle to the new node, or a null handle if the parent is null or full.
+    template <typename... Args>
+    NodeHandle attach(TreeNode* parent, Args&&... args) {
+        if (!parent || parent->children.size() >= K) {
+            return NodeHandle();
+        }
+        Change change(*this);
+        TreeNode* child = pool.create(std::forward<Args>(args)...);
+        link(parent, child);
+        ++node_count;
+        heap_ordered = false;
+        index.insert(child->data.get_value(), child);
+        return NodeHandle(child);
+    }
+
+    /// Sort nodes with several threads: each thread sorts one chunk,
+    /// then neighbouring chunks are merged in parallel rounds.
+    /// @param nodes The nodes to sort.
+    /// @param less The ordering of the nodes.
+    /// @param threads The number of threads.
+    template <typename Less>
+    static void parallel_sort(std::vector<TreeNode*>& nodes, Less less, unsigned threads) {
+        size_t chunk = (nodes.size() + threads - 1) / threads;
+        std::vector<std::thread> workers;
+        for (size_t first = 0; first < nodes.size(); first += chunk) {
+            size_t last = std::min(first + chunk, nodes.size());
+            workers.push_back(std::thread([&nodes, less, first, last]() {
+                std::sort(nodes.begin() + first, nodes.begin() + last, less);
+            }));
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (; chunk < nodes.size(); chunk *= 2) {
+            workers.clear();
+            for (size_t first = 0; first + chunk < nodes.size(); first += 2 * chunk) {
+                size_t middle = first + chunk;
+                size_t last = std::min(first + 2 * chunk, nodes.size());
+                workers.push_back(std::thread([&nodes, less, first, middle, last]() {
+                    std::inplace_merge(nodes.begin() + first, nodes.begin() + middle, nodes.begin() + last, less);
+                }));
+            }
+            for (std::thread& worker : workers) {
+                worker.join();
             }
-            delete node;
         }
     }
 
-    /// Find a node with a specific value.
+    /// Append a node to the children of a parent and point it back to the parent.
+    /// @param parent The parent node, which has fewer than K children.
+    /// @param child The child node.
+    static void link(TreeNode* parent, TreeNode* child) {
+        child->parent = parent;
+        child->slot = static_cast<unsigned>(parent->children.size());
+        parent->children.push_back(child);
+    }
+
+    /// Get the next sibling of a node.
+    /// @param node The node.
+    /// @return The next sibling or nullptr if the node is the last child or the root.
+    static TreeNode* next_sibling(TreeNode* node) {
+        TreeNode* parent = node->parent;
+        if (parent && node->slot + 1 < parent->children.size()) {
+            return parent->children[node->slot + 1];
+        }
+        return nullptr;
+    }
+
+    /// Follow the first children down to a leaf.
     /// @param node The starting node.
-    /// @param val The value to find.
-    /// @return The found node or nullptr if not found.
-    TreeNode* find(TreeNode* node, Node<T> val) {
-        if (!node) return nullptr;
-        if (node->data == val) return node;
-        for (auto child : node->children) {
-            TreeNode* found = find(child, val);
-            if (found) return found;
+    /// @return The leaf.
+    static TreeNode* leftmost_leaf(TreeNode* node) {
+        while (!node->children.empty()) {
+            node = node->children.front();
+        }
+        return node;
+    }
+
+    /// Get the node following a node in pre-order.
+    /// @param node The current node.
+    /// @param top The root of the subtree being walked, nullptr for the whole tree.
+    /// @return The next node or nullptr at the end of the traversal.
+    static TreeNode* next_pre_order(TreeNode* node, TreeNode* top = nullptr) {
+        if (!node->children.empty()) {
+            return node->children.front();
+        }
+        while (node != top) {
+            TreeNode* sibling = next_sibling(node);
+            if (sibling) return sibling;
+            node = node->parent;
         }
         return nullptr;
     }
 
-    /// Draw a node and its children in the scene.
-    /// @param scene The graphics scene.
-    /// @param node The node to draw.
-    /// @param x The x-coordinate.
-    /// @param y The y-coordinate.
-    /// @param hGap The horizontal gap between nodes.
-    /// @param vGap The vertical gap between levels.
-    /// @param depth The depth of the node in the tree.
-    void drawNode(QGraphicsScene& scene, TreeNode* node, int x, int y, int hGap, int vGap, int depth = 0) const {
-        if (!node) return;
-
-        std::ostringstream oss;
-        oss << node->data.getValue();
-        QGraphicsTextItem* textItem = scene.addText(QString::fromStdString(oss.str()));
-        textItem->setDefaultTextColor(Qt::white);  // Set the text color to white
-        textItem->setZValue(1);  // Ensure the text is drawn on top
-
-        // Determine the rectangle border color and edge color based on the depth
-        QColor borderColor, edgeColor;
-        edgeColor = borderColor = QColor(29, 35, 189);
-
-        // Add a rectangle around the text item with the determined border color and set background color
-        QRectF rect = textItem->boundingRect();
-        QColor backgroundColor(85, 85, 90); // Set the background color to match the provided image (dark gray)
-        QGraphicsRectItem* rectItem = scene.addRect(rect.adjusted(-25, -10, 25, 10), QPen(borderColor, 2), QBrush(backgroundColor));
-        rectItem->setPos(x - rect.width() / 2 - 25, y - rect.height() / 2 - 10); // Adjust position to align with text item
-        // Calculate the rectangle's center position
-        int rectCenterX = x - rect.width() / 2 - 25;
-        int rectCenterY = y - rect.height() / 2 - 10;
-        // Set the position of the text item to be in the center of the rectangle
-        textItem->setPos(rectCenterX + rect.width() / 2 - textItem->boundingRect().width() / 2,
-                        rectCenterY + rect.height() / 2 - textItem->boundingRect().height() / 2);
-
-        int screen_padding = 10;
-        int childY = y + vGap; // Adjust vertical gap
-        int numChildren = node->children.size();
-        int childXLow=0; // for left nodes
-        int childXHigh=x - screen_padding + hGap; // for right nodes
-        if (numChildren > 0) {
-            int totalWidth;
-            if(numChildren%2!=0){ // if num of children is odd
-                totalWidth = ((numChildren-1) * hGap) / 2; // so i wont count the one on the middle
-            } else{
-                totalWidth = (numChildren * hGap) / 2;
-            }
-            childXLow = x - totalWidth - screen_padding;
-        }
-
-        int numOfChild = 0;
-        for (TreeNode* child : node->children) 
-        {
-            if (child) {
-                if(numOfChild < numChildren/2 || K == 1){
-                    // Use the edge color for the line
-                    scene.addLine(x - screen_padding - rect.width() / 2, y + rect.height() / 2,
-                                childXLow - rect.width()  , childY - rect.height() / 2 - screen_padding, QPen(edgeColor, 2));
-                    drawNode(scene, child, childXLow, childY, hGap - hGap/3, vGap, depth + 1);
-                    childXLow += hGap;
-                } else if(numOfChild >= numChildren/2){
-                    if(!(numChildren%2!=0 && numOfChild == numChildren/2) || numChildren==1){// if the node in the middle
-                        scene.addLine(x - screen_padding - rect.width() / 2, y + rect.height() / 2,
-                        childXHigh + rect.width()/2, childY - rect.height() / 2 - screen_padding, QPen(edgeColor, 2));
-                        drawNode(scene, child, childXHigh  ,childY, hGap - hGap/3 , vGap, depth + 1);
-                    childXHigh += hGap;
-                    } else{
-                        scene.addLine(x - screen_padding - rect.width() / 2, y + rect.height() / 2,
-                                    x - screen_padding - rect.width() / 2 , childY - rect.height() / 2 - screen_padding, QPen(edgeColor, 2));
-                        drawNode(scene, child, x, childY, hGap - hGap/3, vGap, depth + 1);
+    /// Get the node following a node in post-order.
+    /// @param node The current node.
+    /// @return The next node or nullptr at the end of the traversal.
+    static TreeNode* next_post_order(TreeNode* node) {
+        TreeNode* sibling = next_sibling(node);
+        if (sibling) return leftmost_leaf(sibling);
+        return node->parent;
+    }
+
+    /// Get the node following a node in binary in-order.
+    /// @param node The current node.
+    /// @return The next node or nullptr at the end of the traversal.
+    static TreeNode* next_in_order(TreeNode* node) {
+        // Visit the subtree of the second child, then return to the nearest
+        // ancestor whose first-child subtree we are leaving.
+        if (node->children.size() > 1) {
+            return leftmost_leaf(node->children[1]);
+        }
+        while (node->parent) {
+            if (node->slot == 0) return node->parent;
+            node = node->parent;
+        }
+        return nullptr;
+    }
+
+    /// Destroy every node and reset the tree to empty.
+    void destroy_all() {
+        if (NodePool::bulk_release) {
+            pool.release();
+        } else {
+            clear(root);
+        }
+        root = nullptr;
+        index.clear();
+        heap_ordered = false;
+        node_count = 0;
+    }
+
+    /// Fill this empty tree with a deep copy of another tree.
+    /// @param other The tree to copy.
+    /// @param threads The number of threads to use.
+    void copy_from(const Tree& other, unsigned threads) {
+        if (!other.root) return;
+        // Every copy is linked as soon as it is created, so if a value copy throws, the nodes made
+        // so far hang from root and destroy_all() frees them; ~Tree does not run inside a constructor.
+        try {
+            pool.reserve(other.node_count);
+            root = pool.create(other.root->data);
+            if (threads > 1 && NodePool::thread_safe) {
+                copy_parallel(other, threads);
+            } else {
+                copy_below(other.root, root, pool);
+            }
+            node_count = other.node_count;
+            heap_ordered = other.heap_ordered;
+            if (IndexTable::enabled) {
+                for (TreeNode* node = root; node; node = next_pre_order(node)) {
+                    index.insert(node->data.get_value(), node);
+                }
+            }
+        } catch (...) {
+            destroy_all();
+            throw;
+        }
+    }
+
+    /// Copy the nodes below the root of another tree into this tree's root with several threads.
+    /// An exception thrown by a worker is passed on once every worker has finished.
+    /// @param other The tree to copy, whose root is already copied.
+    /// @param threads The number of threads to use.
+    void copy_parallel(const Tree& other, unsigned threads) {
+        // Copy level by level until one level has a subtree for every thread.
+        std::vector<TreeNode*> level(1, other.root);
+        std::vector<TreeNode*> copies(1, root);
+        while (level.size() < threads) {
+            std::vector<TreeNode*> next_level;
+            std::vector<TreeNode*> next_copies;
+            for (size_t i = 0; i < level.size(); ++i) {
+                for (TreeNode* child : level[i]->children) {
+                    TreeNode* copy = pool.create(child->data);
+                    link(copies[i], copy);
+                    next_level.push_back(child);
+                    next_copies.push_back(copy);
+                }
+            }
+            if (next_level.empty()) break;
+            level.swap(next_level);
+            copies.swap(next_copies);
+        }
+        // Each thread copies the subtrees below every threads-th node of that level.
+        std::vector<std::exception_ptr> errors(threads);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads && t < level.size(); ++t) {
+            workers.push_back(std::thread([this, &level, &copies, &errors, t, threads]() {
+                try {
+                    for (size_t i = t; i < level.size(); i += threads) {
+                        copy_below(level[i], copies[i], pool);
                     }
+                } catch (...) {
+                    errors[t] = std::current_exception();
                 }
+            }));
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (const std::exception_ptr& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+    }
+
+    /// Copy the descendants of a node below the copy of that node, walking in pre-order
+    /// and moving the copy cursor in step with the source.
+    /// @param top The node whose descendants are copied.
+    /// @param copy The copy of top, without children.
+    /// @param pool The pool to create the copies in.
+    static void copy_below(TreeNode* top, TreeNode* copy, NodePool& pool) {
+        TreeNode* source = top;
+        while (true) {
+            TreeNode* next;
+            if (!source->children.empty()) {
+                next = source->children.front();
+            } else {
+                while (source != top && !next_sibling(source)) {
+                    source = source->parent;
+                    copy = copy->parent;
+                }
+                if (source == top) return;
+                next = next_sibling(source);
+                copy = copy->parent;
+            }
+            TreeNode* child = pool.create(next->data);
+            link(copy, child);
+            source = next;
+            copy = child;
+        }
+    }
+
+    /// Delete a subtree without recursion, so the depth of the tree does not matter.
+    /// Repeatedly detach the last child of the current node and descend into it;
+    /// once a node has no children left, delete it and return to its parent.
+    /// Uses O(1) extra space.
+    /// @param node The root of the subtree to delete; its parent must not be deleted through it.
+    void clear(TreeNode* node) {
+        TreeNode* stop = node ? node->parent : nullptr;
+        while (node != stop) {
+            if (!node->children.empty()) {
+                TreeNode* child = node->children.back();
+                node->children.pop_back();
+                node = child;
+            } else {
+                TreeNode* parent = node->parent;
+                pool.destroy(node);
+                node = parent;
             }
-        numOfChild++;
         }
     }
+
+    /// Find a node with a specific value by walking the subtree in pre-order through parent links.
+    /// @param node The starting node.
+    /// @param val The value to find.
+    /// @return The found node or nullptr if not found.
+    TreeNode* find(TreeNode* node, const Node<T>& val) {
+        for (TreeNode* current = node; current; current = next_pre_order(current, node)) {
+            if (current->data == val) return current;
+        }
+        return nullptr;
+    }
 };
 
+template <typename T, int K, typename Index, typename Alloc>
+const std::uint32_t Tree<T, K, Index, Alloc>::Shape::npos;
+
 #endif
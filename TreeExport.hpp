@@ -0,0 +1,195 @@
+#ifndef TREE_EXPORT_HPP
+#define TREE_EXPORT_HPP
+
+#include "FlatTree.hpp"
+#include "TreeLayout.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <streambuf>
+#include <string>
+
+// Writers that render a tree to Graphviz DOT or SVG without any GUI.
+// Both stream their output node by node; the labels, and the SVG lines, go through reused buffers,
+// so no string is built for the whole tree and none is allocated per node.
+
+/// Formats node labels and escapes them, reusing the same buffers for every node.
+class LabelWriter {
+    /// Stream buffer appending to a string, which keeps its capacity between labels.
+    class Appender : public std::streambuf {
+        std::string& out;
+    public:
+        explicit Appender(std::string& out) : out(out) {}
+    protected:
+        int_type overflow(int_type c) override {
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                out.push_back(traits_type::to_char_type(c));
+            }
+            return traits_type::not_eof(c);
+        }
+        std::streamsize xsputn(const char* s, std::streamsize n) override {
+            out.append(s, static_cast<std::size_t>(n));
+            return n;
+        }
+    };
+
+    std::string raw;
+    std::string escaped;
+    Appender buffer;
+    std::ostream text;
+
+public:
+    LabelWriter() : buffer(raw), text(&buffer) {}
+
+    /// Get the text of a value, as Node<T>::toString writes it, escaped for the output format.
+    /// @param value The value.
+    /// @param svg True to escape for SVG text, false for a quoted DOT string.
+    /// @return The escaped label, valid until the next call.
+    template <typename T>
+    const std::string& label(const Node<T>& value, bool svg) {
+        raw.clear();
+        text << value.getValue();
+        escaped.clear();
+        for (char c : raw) {
+            if (svg) {
+                switch (c) {
+                    case '&': escaped += "&amp;"; break;
+                    case '<': escaped += "&lt;"; break;
+                    case '>': escaped += "&gt;"; break;
+                    case '"': escaped += "&quot;"; break;
+                    default: escaped += c;
+                }
+            } else if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (c == '\n') {
+                escaped += "\\n";
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+};
+
+/// Append a coordinate, rounded to whole pixels, to a buffer. Much faster than streaming a double.
+/// @param out The buffer.
+/// @param value The coordinate.
+inline void append_pixels(std::string& out, double value) {
+    long pixels = std::lround(value);
+    unsigned long magnitude = pixels < 0 ? 0UL - static_cast<unsigned long>(pixels) : static_cast<unsigned long>(pixels);
+    char digits[24];
+    std::size_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (pixels < 0) {
+        out += '-';
+    }
+    while (count) {
+        out += digits[--count];
+    }
+}
+
+/// Get the opening lines of a DOT digraph in the colours of the Qt viewer; "}\n" closes it.
+/// @return The lines.
+inline const char* dot_header() {
+    return "digraph Tree {\n"
+           "  node [shape=box, style=filled, fillcolor=\"#55555a\", color=\"#1d23bd\", fontcolor=white];\n"
+           "  edge [color=\"#1d23bd\"];\n";
+}
+
+/// Write a tree as a Graphviz DOT digraph. Node n<i> is the node with BFS index i.
+/// @param os The stream to write to.
+/// @param tree The tree.
+template <typename T, int K>
+void write_dot(std::ostream& os, const FlatTree<T, K>& tree) {
+    LabelWriter labels;
+    os << dot_header();
+    for (std::uint32_t i = 0; i < tree.size(); ++i) {
+        os << "  n" << i << " [label=\"" << labels.label(tree.value(i), false) << "\"];\n";
+        if (tree.parent(i) != FlatTree<T, K>::npos) {
+            os << "  n" << tree.parent(i) << " -> n" << i << ";\n";
+        }
+    }
+    os << "}\n";
+}
+
+/// Write a laid out tree as an SVG image, in the colours of the Qt viewer.
+/// The edges are grouped into a few long paths, the boxes are sized from the label length and all
+/// coordinates are rounded to whole pixels, so the file stays compact even for millions of nodes.
+/// @param os The stream to write to.
+/// @param tree The tree: a FlatTree, or a view with the same size(), parent(i) and value(i).
+/// @param layout The positions of the nodes of tree, in pixels.
+/// @param margin The space around the tree, in pixels.
+template <typename Structure>
+void write_svg(std::ostream& os, const Structure& tree, const TreeLayout& layout, double margin = 40) {
+    const double char_width = 7;    // Approximate width of a character of the 12px font
+    const double box_height = 20;
+    const std::size_t edges_per_path = 4096;
+    const std::size_t flush_size = 1 << 16;
+
+    std::string out = "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"";
+    append_pixels(out, layout.width() + 2 * margin);
+    out += "\" height=\"";
+    append_pixels(out, layout.height() + 2 * margin);
+    out += "\" style=\"background:#262626\">\n"
+           "<style>path{fill:none;stroke:#1d23bd;stroke-width:2}"
+           "rect{fill:#55555a;stroke:#1d23bd;stroke-width:2}"
+           "text{fill:#fff;font:12px sans-serif;text-anchor:middle;dominant-baseline:central}</style>\n";
+
+    // Edges first, so the boxes are drawn over them.
+    for (std::uint32_t i = 1; i < tree.size(); ++i) {
+        if ((i - 1) % edges_per_path == 0) {
+            out += i > 1 ? "\"/>\n<path d=\"" : "<path d=\"";
+        }
+        std::uint32_t p = tree.parent(i);
+        out += 'M';
+        append_pixels(out, margin + layout.x(p));
+        out += ' ';
+        append_pixels(out, margin + layout.y(p));
+        out += 'L';
+        append_pixels(out, margin + layout.x(i));
+        out += ' ';
+        append_pixels(out, margin + layout.y(i));
+        if (out.size() >= flush_size) {
+            os.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    }
+    if (tree.size() > 1) {
+        out += "\"/>\n";
+    }
+
+    LabelWriter labels;
+    for (std::uint32_t i = 0; i < tree.size(); ++i) {
+        const std::string& label = labels.label(tree.value(i), true);
+        double x = margin + layout.x(i), y = margin + layout.y(i);
+        double width = 16 + char_width * label.size();
+        out += "<rect x=\"";
+        append_pixels(out, x - width / 2);
+        out += "\" y=\"";
+        append_pixels(out, y - box_height / 2);
+        out += "\" width=\"";
+        append_pixels(out, width);
+        out += "\" height=\"";
+        append_pixels(out, box_height);
+        out += "\"/><text x=\"";
+        append_pixels(out, x);
+        out += "\" y=\"";
+        append_pixels(out, y);
+        out += "\">";
+        out += label;
+        out += "</text>\n";
+        if (out.size() >= flush_size) {
+            os.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    }
+    out += "</svg>\n";
+    os.write(out.data(), static_cast<std::streamsize>(out.size()));
+}
+
+#endif
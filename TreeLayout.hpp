@@ -0,0 +1,180 @@
+#ifndef TREE_LAYOUT_HPP
+#define TREE_LAYOUT_HPP
+
+#include "FlatTree.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// Node coordinates for drawing a tree, computed without any GUI.
+/// The layout follows Reingold and Tilford, in the linear-time form of Buchheim, Juenger and Leipert:
+/// every parent is centred above its children, subtrees are pushed apart just enough to keep
+/// node_gap between neighbours on every level, and the space is spread evenly between the
+/// subtrees in between. Both passes walk the BFS arrays of a FlatTree, so no recursion is needed.
+/// The coordinates are indexed by the BFS index of the node in that FlatTree.
+/// Only the structure is read, so any view with the BFS arrays of a FlatTree can be laid out as well.
+class TreeLayout {
+    std::vector<double> xs;
+    std::vector<double> ys;
+    double total_width;
+    double total_height;
+
+public:
+    /// Construct an empty layout.
+    TreeLayout() : total_width(0), total_height(0) {}
+
+    /// Lay out a tree.
+    /// @param tree The tree: a FlatTree, or a view with the same npos, size(), parent(i),
+    ///             first_child(i) and child_count(i) over nodes numbered in BFS order.
+    /// @param node_gap The horizontal distance between neighbouring nodes on a level.
+    /// @param level_gap The vertical distance between levels.
+    template <typename Structure, typename = decltype(std::declval<const Structure&>().first_child(0))>
+    explicit TreeLayout(const Structure& tree, double node_gap = 1.0, double level_gap = 1.0)
+        : total_width(0), total_height(0) {
+        const std::uint32_t npos = Structure::npos;
+        const std::uint32_t count = static_cast<std::uint32_t>(tree.size());
+        xs.assign(count, 0.0);
+        ys.assign(count, 0.0);
+        if (count == 0) {
+            return;
+        }
+
+        // Per-node state of the first pass. prelim is the x position relative to the parent's subtree,
+        // mod the offset still to be added to the whole subtree below the node.
+        std::vector<double>& prelim = xs;
+        std::vector<double> mod(count, 0.0), shift(count, 0.0), change(count, 0.0);
+        std::vector<std::uint32_t> thread(count, npos), ancestor(count);
+        for (std::uint32_t v = 0; v < count; ++v) {
+            ancestor[v] = v;
+        }
+
+        // The contour of a subtree continues with the outermost child, or the thread when there is none.
+        auto next_left = [&](std::uint32_t v) {
+            return tree.child_count(v) ? tree.first_child(v) : thread[v];
+        };
+        auto next_right = [&](std::uint32_t v) {
+            return tree.child_count(v) ? tree.first_child(v) + tree.child_count(v) - 1 : thread[v];
+        };
+
+        // Place the children of a node next to each other, given that their own subtrees are laid out
+        // and that the prelim of every inner child holds the midpoint of its children.
+        auto place_children = [&](std::uint32_t v) {
+            const std::uint32_t first = tree.first_child(v);
+            const std::uint32_t last = first + tree.child_count(v) - 1;
+            std::uint32_t default_ancestor = first;
+            for (std::uint32_t w = first + 1; w <= last; ++w) {
+                const double midpoint = prelim[w];
+                prelim[w] = prelim[w - 1] + node_gap;
+                if (tree.child_count(w)) {
+                    mod[w] = prelim[w] - midpoint;
+                }
+
+                // Walk down the right contour of the left siblings and the left contour of w,
+                // pushing w to the right wherever the two come closer than node_gap.
+                std::uint32_t vir = w, vor = w, vil = w - 1, vol = first;
+                double sir = mod[vir], sor = mod[vor], sil = mod[vil], sol = mod[vol];
+                while (next_right(vil) != npos && next_left(vir) != npos) {
+                    vil = next_right(vil);
+                    vir = next_left(vir);
+                    vol = next_left(vol);
+                    vor = next_right(vor);
+                    ancestor[vor] = w;
+                    const double gap = (prelim[vil] + sil) - (prelim[vir] + sir) + node_gap;
+                    if (gap > 0) {
+                        // The subtree to move away from: the sibling subtree the left contour belongs to.
+                        const std::uint32_t wl = tree.parent(ancestor[vil]) == v ? ancestor[vil] : default_ancestor;
+                        const double subtrees = static_cast<double>(w - wl);
+                        change[w] -= gap / subtrees;
+                        shift[w] += gap;
+                        change[wl] += gap / subtrees;
+                        prelim[w] += gap;
+                        mod[w] += gap;
+                        sir += gap;
+                        sor += gap;
+                    }
+                    sil += mod[vil];
+                    sir += mod[vir];
+                    sol += mod[vol];
+                    sor += mod[vor];
+                }
+                // Thread the shallower contour onto the deeper one.
+                if (next_right(vil) != npos && next_right(vor) == npos) {
+                    thread[vor] = next_right(vil);
+                    mod[vor] += sil - sor;
+                }
+                if (next_left(vir) != npos && next_left(vol) == npos) {
+                    thread[vol] = next_left(vir);
+                    mod[vol] += sir - sol;
+                    default_ancestor = w;
+                }
+            }
+
+            // Spread the shifts evenly over the siblings between the moved subtrees.
+            double total_shift = 0, total_change = 0;
+            for (std::uint32_t w = last + 1; w-- > first;) {
+                prelim[w] += total_shift;
+                mod[w] += total_shift;
+                total_change += change[w];
+                total_shift += shift[w] + total_change;
+            }
+            prelim[v] = (prelim[first] + prelim[last]) / 2;
+        };
+
+        // First pass, bottom-up: in reverse BFS order every node comes after all of its descendants.
+        for (std::uint32_t v = count; v-- > 0;) {
+            if (tree.child_count(v)) {
+                place_children(v);
+            }
+        }
+
+        // Second pass, top-down: in BFS order every node comes after its parent.
+        std::vector<double>& offset = shift; // now the sum of the mods of the ancestors
+        std::vector<std::uint32_t>& depth = ancestor;
+        offset[0] = 0;
+        depth[0] = 0;
+        double min_x = prelim[0], max_x = prelim[0];
+        std::uint32_t max_depth = 0;
+        for (std::uint32_t v = 0; v < count; ++v) {
+            if (v > 0) {
+                const std::uint32_t p = tree.parent(v);
+                offset[v] = offset[p] + mod[p];
+                depth[v] = depth[p] + 1;
+            }
+            xs[v] = prelim[v] + offset[v];
+            min_x = xs[v] < min_x ? xs[v] : min_x;
+            max_x = xs[v] > max_x ? xs[v] : max_x;
+            max_depth = depth[v] > max_depth ? depth[v] : max_depth;
+        }
+        for (std::uint32_t v = 0; v < count; ++v) {
+            xs[v] -= min_x;
+            ys[v] = depth[v] * level_gap;
+        }
+        total_width = max_x - min_x;
+        total_height = max_depth * level_gap;
+    }
+
+    /// Get the number of nodes laid out.
+    /// @return The number of nodes.
+    std::size_t size() const { return xs.size(); }
+
+    /// Get the horizontal position of a node; the leftmost node is at 0.
+    /// @param i The BFS index of the node.
+    /// @return The x coordinate.
+    double x(std::uint32_t i) const { return xs[i]; }
+
+    /// Get the vertical position of a node; the root is at 0.
+    /// @param i The BFS index of the node.
+    /// @return The y coordinate.
+    double y(std::uint32_t i) const { return ys[i]; }
+
+    /// Get the distance between the leftmost and the rightmost node.
+    /// @return The width.
+    double width() const { return total_width; }
+
+    /// Get the distance between the root and the deepest level.
+    /// @return The height.
+    double height() const { return total_height; }
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef TREE_SNAPSHOT_HPP
+#define TREE_SNAPSHOT_HPP
+
+#include "FlatTree.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+/// The link between a tree and the viewers following it from another thread.
+/// The tree holds the mutex while it changes and sets changed afterwards; a follower polls changed
+/// and takes a FlatTree snapshot under the same mutex, so it never sees a tree halfway through a change.
+/// @tparam T The type of the values.
+/// @tparam K The maximum number of children per node.
+template <typename T, int K>
+struct SnapshotSource {
+    std::mutex mutex;                      ///< Held while the tree changes and while a snapshot is taken.
+    std::function<FlatTree<T, K>()> take;  ///< Take a snapshot; empty once the tree is destroyed.
+    std::atomic<bool> changed;             ///< Set by every change of the tree.
+
+    SnapshotSource() : changed(false) {}
+};
+
+#endif
@@ -0,0 +1,385 @@
+#ifndef TREE_VIEWER_HPP
+#define TREE_VIEWER_HPP
+
+#include "Tree.hpp"
+#include "FlatTree.hpp"
+#include "TreeLayout.hpp"
+#include "TreeSnapshot.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <QApplication>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QGraphicsSimpleTextItem>
+#include <QGraphicsLineItem>
+#include <QGraphicsRectItem>
+#include <QMetaObject>
+#include <QTimer>
+#include <QWheelEvent>
+
+// The Qt viewer of the tree container. Tree.hpp itself does not depend on Qt;
+// only programs that include this header need the Qt5Widgets build flags.
+
+/// A Qt window showing a snapshot of a tree.
+/// The tree is laid out once with TreeLayout, but scene items are only created for the part of the
+/// tree inside the viewport, and again when scrolling, zooming or resizing changes which nodes are in view.
+/// Each level is drawn node by node while the nodes are far enough apart on screen to be readable
+/// and the item budget allows it; below that level whole subtrees are collapsed into summary boxes
+/// showing their node count, which open up as the user zooms in.
+/// @tparam T The type of the values.
+/// @tparam K The maximum number of children per node.
+template <typename T, int K = 2>
+class TreeViewer : public QGraphicsView {
+public:
+    static constexpr double node_gap = 150;     ///< Horizontal gap between neighbouring nodes.
+    static constexpr double level_gap = 100;    ///< Vertical gap between levels.
+    static constexpr double margin = 75;        ///< Space around the tree.
+    static constexpr double min_screen_gap = 40; ///< Smallest on-screen gap at which nodes are drawn one by one.
+    static const std::size_t node_budget = 2000; ///< Most nodes and summary boxes drawn at once, plus one.
+
+    /// Construct a viewer for a tree.
+    /// @param tree The tree to show, copied into the viewer.
+    explicit TreeViewer(const FlatTree<T, K>& tree) {
+        setScene(&scene);
+
+        // Enable antialiasing for smoother rendering of graphics.
+        setRenderHint(QPainter::Antialiasing);
+        // Only the items of the visible region exist, so repaint just the parts that change.
+        setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+        setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+        setDragMode(QGraphicsView::ScrollHandDrag);
+
+        // Set a gradient background for a more professional look.
+        QLinearGradient gradient(0, 0, 0, 800);
+        gradient.setColorAt(0, QColor(60, 60, 60)); // Darker gray at the top.
+        gradient.setColorAt(1, QColor(30, 30, 30)); // Even darker gray at the bottom.
+        setBackgroundBrush(gradient);
+
+        setWindowTitle("Tree Visualization");
+        resize(1600, 900);
+        set_tree(tree);
+    }
+
+    /// Show another snapshot, keeping the scroll position and zoom.
+    /// @param tree The tree to show, copied into the viewer.
+    void set_tree(const FlatTree<T, K>& tree) {
+        flat = tree;
+        layout = TreeLayout(flat, node_gap, level_gap);
+        summarize();
+        stale = true;
+        scene.setSceneRect(0, 0, layout.width() + 2 * margin, layout.height() + 2 * margin);
+        refresh();
+    }
+
+    /// Follow a tree that keeps changing on another thread.
+    /// A timer on the GUI thread checks for changes and, when there are any, takes a new snapshot,
+    /// so a burst of changes costs one snapshot per period. Following stops when the tree is destroyed.
+    /// @param source The snapshot source of the tree.
+    /// @param period_ms The time between checks, in milliseconds.
+    void follow(const std::shared_ptr<SnapshotSource<T, K>>& source, int period_ms) {
+        QTimer* timer = new QTimer(this);
+        QObject::connect(timer, &QTimer::timeout, [this, source, timer]() {
+            if (!source->changed.exchange(false)) {
+                return;
+            }
+            FlatTree<T, K> snapshot;
+            {
+                std::lock_guard<std::mutex> lock(source->mutex);
+                if (!source->take) {
+                    timer->stop();
+                    return;
+                }
+                snapshot = source->take();
+            }
+            set_tree(snapshot);
+        });
+        timer->start(period_ms);
+    }
+
+    /// Rebuild the scene items for the visible region, unless the same nodes and summaries are shown already.
+    void refresh() {
+        plan(wanted);
+        if (!stale && wanted == shown) {
+            return;
+        }
+        std::swap(shown, wanted);
+        stale = false;
+        scene.clear();
+        for (std::size_t r = 0; r < shown.runs.size(); r += 2) {
+            for (std::uint32_t i = shown.runs[r]; i < shown.runs[r + 1]; ++i) {
+                drawNode(i);
+            }
+        }
+        for (std::uint32_t i = shown.summary_first; i < shown.summary_end; ++i) {
+            drawSummary(i, shown.connect);
+        }
+    }
+
+protected:
+    void scrollContentsBy(int dx, int dy) override {
+        QGraphicsView::scrollContentsBy(dx, dy);
+        refresh();
+    }
+
+    void resizeEvent(QResizeEvent* event) override {
+        QGraphicsView::resizeEvent(event);
+        refresh();
+    }
+
+    void showEvent(QShowEvent* event) override {
+        QGraphicsView::showEvent(event);
+        refresh();
+    }
+
+    /// Zoom around the mouse position.
+    void wheelEvent(QWheelEvent* event) override {
+        double factor = std::pow(1.0015, event->angleDelta().y());
+        scale(factor, factor);
+        refresh();
+    }
+
+private:
+    FlatTree<T, K> flat;
+    TreeLayout layout;
+    QGraphicsScene scene;
+    std::ostringstream label;
+
+    std::vector<std::uint32_t> level_start;    ///< BFS index of the first node of each level, then the node count.
+    std::vector<std::uint32_t> subtree_size;   ///< Number of nodes in the subtree of each node.
+    std::vector<double> subtree_left;          ///< Smallest x in the subtree of each node.
+    std::vector<double> subtree_right;         ///< Largest x in the subtree of each node.
+    std::vector<double> subtree_bottom;        ///< Largest y in the subtree of each node.
+
+    /// The nodes in the scene: a run of nodes on each drawn level, then a run of collapsed subtrees.
+    struct Shown {
+        std::vector<std::uint32_t> runs;   ///< BFS index of the first node and one past the last, per drawn level.
+        std::uint32_t summary_first = 0;   ///< BFS index of the first collapsed subtree.
+        std::uint32_t summary_end = 0;     ///< One past the BFS index of the last collapsed subtree.
+        bool connect = false;              ///< Whether the collapsed subtrees hang from drawn nodes.
+
+        bool operator==(const Shown& other) const {
+            return runs == other.runs && summary_first == other.summary_first &&
+                   summary_end == other.summary_end && connect == other.connect;
+        }
+    };
+    Shown shown;        ///< What the scene holds.
+    Shown wanted;       ///< What the visible region needs, reused to avoid allocating on every scroll step.
+    bool stale = true;  ///< Whether the scene is out of date regardless of the visible region, after set_tree().
+
+    /// Find the levels and the extent of every subtree, children before parents in reverse BFS order.
+    void summarize() {
+        std::uint32_t count = static_cast<std::uint32_t>(flat.size());
+        level_start.clear();
+        subtree_size.assign(count, 1);
+        subtree_left.resize(count);
+        subtree_right.resize(count);
+        subtree_bottom.resize(count);
+        for (std::uint32_t i = 0; i < count; ++i) {
+            subtree_left[i] = subtree_right[i] = layout.x(i);
+            subtree_bottom[i] = layout.y(i);
+            if (i == 0 || layout.y(i) != layout.y(i - 1)) {
+                level_start.push_back(i);
+            }
+        }
+        level_start.push_back(count);
+        for (std::uint32_t i = count; i-- > 1;) {
+            std::uint32_t p = flat.parent(i);
+            subtree_size[p] += subtree_size[i];
+            subtree_left[p] = std::min(subtree_left[p], subtree_left[i]);
+            subtree_right[p] = std::max(subtree_right[p], subtree_right[i]);
+            subtree_bottom[p] = std::max(subtree_bottom[p], subtree_bottom[i]);
+        }
+    }
+
+    /// Find the nodes of a level whose x lies in a range, by binary search: BFS order lists a level from left to right.
+    /// @param level The level.
+    /// @param left The smallest x.
+    /// @param right The largest x.
+    /// @param lo Receives the BFS index of the first node in the range.
+    /// @param hi Receives the BFS index one past the last node in the range.
+    void visible_range(std::size_t level, double left, double right, std::uint32_t& lo, std::uint32_t& hi) const {
+        lo = level_start[level];
+        hi = level_start[level + 1];
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            if (layout.x(mid) < left) lo = mid + 1; else hi = mid;
+        }
+        hi = level_start[level + 1];
+        std::uint32_t end = lo;
+        while (end < hi) {
+            std::uint32_t mid = end + (hi - end) / 2;
+            if (layout.x(mid) <= right) end = mid + 1; else hi = mid;
+        }
+        hi = end;
+    }
+
+    /// Find the nodes and summaries to show for the visible region.
+    /// @param out Receives the runs of nodes to draw and the run of subtrees to collapse.
+    void plan(Shown& out) const {
+        out.runs.clear();
+        out.summary_first = out.summary_end = 0;
+        out.connect = false;
+        if (flat.empty()) {
+            return;
+        }
+        QRectF visible = mapToScene(viewport()->rect()).boundingRect();
+        bool readable = node_gap * transform().m11() >= min_screen_gap;
+
+        // Visible levels, and the visible x range widened by a node so partly visible boxes are drawn.
+        double left = visible.left() - margin - node_gap;
+        double right = visible.right() - margin + node_gap;
+        std::size_t levels = level_start.size() - 1;
+        double top = std::floor((visible.top() - margin) / level_gap);
+        double bottom = std::ceil((visible.bottom() - margin) / level_gap);
+        std::size_t first_level = top < 0 ? 0 : std::min(static_cast<std::size_t>(top), levels - 1);
+        std::size_t last_level = bottom < 0 ? 0 : std::min(static_cast<std::size_t>(bottom), levels - 1);
+
+        // Draw whole levels from the top while they fit in the budget and are readable.
+        std::size_t drawn = 0;
+        std::size_t level = first_level;
+        std::uint32_t lo = 0, hi = 0;
+        for (; level <= last_level; ++level) {
+            visible_range(level, left, right, lo, hi);
+            std::size_t count = hi - lo;
+            if (count > node_budget - drawn || (count > 1 && !readable)) {
+                break;
+            }
+            out.runs.push_back(lo);
+            out.runs.push_back(hi);
+            drawn += count;
+        }
+
+        // Too many nodes: collapse the level into the subtrees of the nodes one level up. When the deepest
+        // drawn level has too many of those for what is left of the budget, it is collapsed as well,
+        // rather than covered by summary boxes. Above the first visible level the ancestors of a run of
+        // nodes form a run on every level, down to the root alone when the budget is spent.
+        if (level > last_level) {
+            return;
+        }
+        std::uint32_t first = lo, last = hi - 1;
+        for (;;) {
+            first = flat.parent(first);
+            last = flat.parent(last);
+            if (out.runs.empty()) {
+                while (last - first + 1 > node_budget && first != 0) {
+                    first = flat.parent(first);
+                    last = flat.parent(last);
+                }
+                break;
+            }
+            if (last - first + 1 <= node_budget - drawn) {
+                out.connect = true;
+                break;
+            }
+            drawn -= out.runs.back() - out.runs[out.runs.size() - 2];
+            out.runs.resize(out.runs.size() - 2);
+        }
+        out.summary_first = first;
+        out.summary_end = last + 1;
+    }
+
+    /// Draw a node and the edge to its parent.
+    /// @param i The BFS index of the node.
+    void drawNode(std::uint32_t i) {
+        QColor borderColor, edgeColor;
+        edgeColor = borderColor = QColor(29, 35, 189);
+        QColor backgroundColor(85, 85, 90); // Set the background color to match the provided image (dark gray)
+        double x = margin + layout.x(i);
+        double y = margin + layout.y(i);
+
+        label.str("");
+        label << flat.value(i).getValue();
+        QGraphicsSimpleTextItem* textItem = scene.addSimpleText(QString::fromStdString(label.str()));
+        textItem->setBrush(Qt::white);  // Set the text color to white
+        textItem->setZValue(1);  // Ensure the text is drawn on top
+
+        // Add a rectangle around the text item, both centred on the node position
+        QRectF rect = textItem->boundingRect();
+        QGraphicsRectItem* rectItem = scene.addRect(rect.adjusted(-25, -10, 25, 10), QPen(borderColor, 2), QBrush(backgroundColor));
+        rectItem->setPos(x - rect.width() / 2, y - rect.height() / 2);
+        textItem->setPos(x - rect.width() / 2, y - rect.height() / 2);
+
+        // Connect the bottom of the parent box to the top of this one
+        std::uint32_t parent = flat.parent(i);
+        if (parent != FlatTree<T, K>::npos) {
+            QGraphicsLineItem* line = scene.addLine(margin + layout.x(parent), margin + layout.y(parent) + rect.height() / 2 + 10,
+                                                    x, y - rect.height() / 2 - 10, QPen(edgeColor, 2));
+            line->setZValue(-1); // Keep the edges behind the boxes
+        }
+    }
+
+    /// Draw one box covering everything below a node, labelled with the number of nodes in it.
+    /// @param i The BFS index of the node.
+    /// @param connect Whether to draw the edge from the node, when the node itself is drawn.
+    void drawSummary(std::uint32_t i, bool connect) {
+        if (subtree_size[i] == 1) {
+            return;
+        }
+        QColor borderColor(29, 35, 189);
+        QColor backgroundColor(55, 55, 70);
+        double top = margin + layout.y(i) + level_gap / 2;
+        double left = margin + subtree_left[i] - node_gap / 3;
+        double right = margin + subtree_right[i] + node_gap / 3;
+        double bottom = margin + subtree_bottom[i] + level_gap / 3;
+        QPen pen(borderColor, 2);
+        pen.setStyle(Qt::DashLine);
+        scene.addRect(left, top, right - left, bottom - top, pen, QBrush(backgroundColor));
+
+        label.str("");
+        label << subtree_size[i] - 1 << " nodes";
+        QGraphicsSimpleTextItem* textItem = scene.addSimpleText(QString::fromStdString(label.str()));
+        textItem->setBrush(Qt::white);
+        textItem->setZValue(1);
+        textItem->setPos((left + right) / 2 - textItem->boundingRect().width() / 2, top + 5);
+
+        if (connect) {
+            QGraphicsLineItem* line = scene.addLine(margin + layout.x(i), margin + layout.y(i), margin + layout.x(i), top, QPen(borderColor, 2));
+            line->setZValue(-1);
+        }
+    }
+};
+
+/// Print a tree in a graphical user interface, blocking until the window is closed.
+/// The window shows a snapshot of the tree and only creates items for the visible part, see TreeViewer.
+/// @param tree The tree to show.
+template <typename T, int K, typename Index, typename Alloc>
+void printTreeGUI(const Tree<T, K, Index, Alloc>& tree) {
+    TreeViewer<T, K> view{FlatTree<T, K>(tree)};
+
+    // Display the view.
+    view.show();
+
+    // Start the Qt event loop to handle user interaction and updates.
+    QApplication::exec();
+}
+
+/// Open a tree in a TreeViewer window and return at once, without waiting for the window to close.
+/// The tree is copied into a FlatTree snapshot on the calling thread and the window is created on the
+/// GUI thread, whose QApplication event loop must be running. From then on the window follows the tree
+/// through Tree::snapshot_source(), taking a fresh snapshot at most once per refresh period after a change.
+/// @param tree The tree to show; it may keep changing on the calling thread.
+/// @param refresh_ms The time between checks for changes, in milliseconds.
+/// @throws std::runtime_error if there is no QApplication.
+template <typename T, int K, typename Index, typename Alloc>
+void show_async(Tree<T, K, Index, Alloc>& tree, int refresh_ms = 250) {
+    if (!QCoreApplication::instance()) {
+        throw std::runtime_error("show_async: no QApplication has been created");
+    }
+    std::shared_ptr<SnapshotSource<T, K>> followed = tree.snapshot_source();
+    std::shared_ptr<FlatTree<T, K>> snapshot = std::make_shared<FlatTree<T, K>>(tree);
+    QMetaObject::invokeMethod(QCoreApplication::instance(), [followed, snapshot, refresh_ms]() {
+        TreeViewer<T, K>* viewer = new TreeViewer<T, K>(*snapshot);
+        viewer->setAttribute(Qt::WA_DeleteOnClose);
+        viewer->follow(followed, refresh_ms);
+        viewer->show();
+    }, Qt::QueuedConnection);
+}
+
+#endif
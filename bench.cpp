@@ -0,0 +1,439 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "Tree.hpp"
+#include "Complex.hpp"
+
+using namespace std;
+
+// Microbenchmarks of building, traversing, heap ordering and destroying trees.
+// Every combination of value type, arity, allocator, index, insertion, shape and size is measured, and each
+// operation is printed as one CSV line or JSON object, so runs can be compared across commits:
+//   bench --n 100000,1000000 --k 2 --shape random --type double --reps 5 --format json
+// --op picks out single operations, e.g. tearing down a 10 million node chain:
+//   bench --op destroy --n 10000000 --k 1 --shape skewed --type double --reps 3
+// --insert and --index compare building by handle with looking every parent up by value:
+//   bench --op build --insert handle,value --index hash --reps 3
+
+// The operations measured on every tree, in the order they run.
+enum Op { Build, PreOrder, PostOrder, InOrder, BFSScan, DFSScan, Heap, MyHeap, HeapAfterMyHeap, Destroy, OpCount };
+const vector<string> opNames = {"build", "pre_order", "post_order", "in_order", "bfs_scan", "dfs_scan", "heap",
+                                "myHeap", "heap_after_myHeap", "destroy"};
+
+// Command line options, each a list of the values to combine.
+struct Options {
+    vector<size_t> sizes = {100000};
+    vector<int> arities = {2, 3, 8};
+    vector<string> shapes = {"balanced", "skewed", "random"};
+    vector<string> types = {"double", "Complex", "string"};
+    vector<string> allocs = {"new", "arena"};
+    vector<string> indexes = {"none"};
+    vector<string> inserts = {"handle"};
+    vector<string> ops = opNames;
+    size_t reps = 5;
+    HeapMode heap_mode = HeapMode::Sorted;
+    bool json = false;
+};
+
+// The times of one operation over all repetitions.
+struct Result {
+    string type;
+    int k;
+    string alloc;
+    string index;
+    string insert;
+    string shape;
+    size_t n;
+    string op;
+    vector<double> ms;
+};
+
+// Results are printed as soon as they are complete, so a long run can be followed.
+class Reporter {
+    bool json;
+    bool first;
+public:
+    explicit Reporter(bool json) : json(json), first(true) {
+        if (json) {
+            cout << "[" << endl;
+        } else {
+            cout << "type,k,alloc,index,insert,shape,n,op,reps,min_ms,median_ms,ns_per_node" << endl;
+        }
+    }
+
+    ~Reporter() {
+        if (json) {
+            cout << (first ? "" : "\n") << "]" << endl;
+        }
+    }
+
+    void report(Result& r) {
+        sort(r.ms.begin(), r.ms.end());
+        double min_ms = r.ms.front();
+        double median_ms = r.ms[r.ms.size() / 2];
+        double ns_per_node = min_ms * 1e6 / static_cast<double>(r.n);
+        if (json) {
+            cout << (first ? "" : ",\n") << "  {\"type\": \"" << r.type << "\", \"k\": " << r.k
+                 << ", \"alloc\": \"" << r.alloc << "\", \"index\": \"" << r.index
+                 << "\", \"insert\": \"" << r.insert << "\", \"shape\": \"" << r.shape << "\", \"n\": " << r.n
+                 << ", \"op\": \"" << r.op << "\", \"reps\": " << r.ms.size() << ", \"min_ms\": " << min_ms
+                 << ", \"median_ms\": " << median_ms << ", \"ns_per_node\": " << ns_per_node << "}";
+        } else {
+            cout << r.type << ',' << r.k << ',' << r.alloc << ',' << r.index << ',' << r.insert << ',' << r.shape << ',' << r.n << ',' << r.op << ','
+                 << r.ms.size() << ',' << min_ms << ',' << median_ms << ',' << ns_per_node << endl;
+        }
+        first = false;
+    }
+};
+
+// Keeps the traversals from being optimized away.
+volatile uintptr_t sink;
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Get the parent of every node but the root, by BFS index of the insertion order.
+// balanced: a complete tree, filled level by level.
+// skewed: a caterpillar, a spine where the first child of every spine node continues the spine.
+// random: every node goes under a uniformly chosen node that still has room.
+vector<size_t> makeParents(const string& shape, size_t n, size_t k, mt19937_64& rng) {
+    vector<size_t> parents(n, 0);
+    if (shape == "balanced") {
+        for (size_t i = 1; i < n; ++i) {
+            parents[i] = (i - 1) / k;
+        }
+    } else if (shape == "skewed") {
+        size_t spine = 0, next_spine = 0, children = 0;
+        for (size_t i = 1; i < n; ++i) {
+            parents[i] = spine;
+            if (children++ == 0) {
+                next_spine = i;
+            }
+            if (children == k) {
+                spine = next_spine;
+                children = 0;
+            }
+        }
+    } else {
+        vector<size_t> open = {0}, counts(n, 0);
+        for (size_t i = 1; i < n; ++i) {
+            size_t j = uniform_int_distribution<size_t>(0, open.size() - 1)(rng);
+            size_t parent = open[j];
+            parents[i] = parent;
+            if (++counts[parent] == k) {
+                open[j] = open.back();
+                open.pop_back();
+            }
+            open.push_back(i);
+        }
+    }
+    return parents;
+}
+
+// Random values of each type, so sorting and heap ordering have real work to do.
+void makeValue(mt19937_64& rng, double& value) {
+    value = uniform_real_distribution<double>(0, 1e6)(rng);
+}
+
+void makeValue(mt19937_64& rng, Complex& value) {
+    uniform_real_distribution<double> dist(-1e3, 1e3);
+    double real = dist(rng);
+    value = Complex(real, dist(rng));
+}
+
+void makeValue(mt19937_64& rng, string& value) {
+    value = "v" + to_string(rng() % 100000000);
+}
+
+// The hash of the index: std::hash, and the two parts for Complex, which has none.
+template <typename T>
+struct ValueHash : hash<T> {};
+
+template <>
+struct ValueHash<Complex> {
+    size_t operator()(const Complex& value) const {
+        return hash<double>()(value.real) * 31 + hash<double>()(value.imag);
+    }
+};
+
+// Draw the values of a tree, drawing repeated ones again, so a parent looked up by value is the intended one.
+template <typename T>
+vector<T> makeValues(mt19937_64& rng, size_t n) {
+    vector<T> values(n);
+    unordered_set<T, ValueHash<T>> seen;
+    for (T& value : values) {
+        do {
+            makeValue(rng, value);
+        } while (!seen.insert(value).second);
+    }
+    return values;
+}
+
+// Walk a traversal to its end, checking that every node was visited.
+template <typename Iterator>
+double walkMs(Iterator it, Iterator end, size_t n, const string& op) {
+    auto start = chrono::steady_clock::now();
+    uintptr_t sum = 0;
+    size_t visited = 0;
+    for (; it != end; ++it) {
+        sum += reinterpret_cast<uintptr_t>(&(*it).getValue());
+        ++visited;
+    }
+    double ms = elapsedMs(start);
+    sink = sum;
+    if (visited != n) {
+        cerr << op << " visited " << visited << " of " << n << " nodes" << endl;
+        exit(1);
+    }
+    return ms;
+}
+
+// Measure every operation on one kind of tree, for all insertions, shapes and sizes.
+// Insertion by value without an index searches the tree for every parent, so it takes quadratic time.
+template <typename T, int K, typename Alloc, typename Index>
+void benchTree(const Options& options, const string& type, const string& alloc, const string& index,
+               Reporter& reporter) {
+    typedef Tree<T, K, Index, Alloc> TreeType;
+    for (const string& shape : options.shapes) {
+        for (size_t n : options.sizes) {
+            // The same tree for every repetition, and for every type, allocator, index and insertion.
+            mt19937_64 rng(42);
+            vector<size_t> parents = makeParents(shape, n, K, rng);
+            vector<T> values = makeValues<T>(rng, n);
+            vector<typename TreeType::NodeHandle> handles(n);
+            for (const string& insert : options.inserts) {
+
+                // Operations that were not asked for are skipped; the tree is built and destroyed anyway.
+                vector<bool> wanted(OpCount);
+                vector<Result> results;
+                for (size_t op = 0; op < OpCount; ++op) {
+                    wanted[op] = find(options.ops.begin(), options.ops.end(), opNames[op]) != options.ops.end();
+                    results.push_back(Result{type, K, alloc, index, insert, shape, n, opNames[op], {}});
+                }
+                // myHeap only reorders binary trees.
+                if (K != 2) {
+                    wanted[MyHeap] = wanted[HeapAfterMyHeap] = false;
+                }
+
+                for (size_t rep = 0; rep < options.reps; ++rep) {
+                    TreeType* tree = new TreeType();
+
+                    auto start = chrono::steady_clock::now();
+                    handles[0] = tree->add_root(values[0]);
+                    if (insert == "handle") {
+                        for (size_t i = 1; i < n; ++i) {
+                            handles[i] = tree->add_sub_node(handles[parents[i]], values[i]);
+                        }
+                    } else {
+                        for (size_t i = 1; i < n; ++i) {
+                            tree->add_sub_node(values[parents[i]], values[i]);
+                        }
+                    }
+                    results[Build].ms.push_back(elapsedMs(start));
+                    if (tree->size() != n) {
+                        cerr << "build inserted " << tree->size() << " of " << n << " nodes" << endl;
+                        exit(1);
+                    }
+
+                    if (wanted[PreOrder]) {
+                        results[PreOrder].ms.push_back(walkMs(tree->begin_pre_order(), tree->end_pre_order(), n, "pre_order"));
+                    }
+                    if (wanted[PostOrder]) {
+                        results[PostOrder].ms.push_back(walkMs(tree->begin_post_order(), tree->end_post_order(), n, "post_order"));
+                    }
+                    if (wanted[InOrder]) {
+                        results[InOrder].ms.push_back(walkMs(tree->begin_in_order(), tree->end_in_order(), n, "in_order"));
+                    }
+                    if (wanted[BFSScan]) {
+                        results[BFSScan].ms.push_back(walkMs(tree->begin_bfs_scan(), tree->end_bfs_scan(), n, "bfs_scan"));
+                    }
+                    if (wanted[DFSScan]) {
+                        results[DFSScan].ms.push_back(walkMs(tree->begin_dfs_scan(), tree->end_dfs_scan(), n, "dfs_scan"));
+                    }
+                    if (wanted[Heap]) {
+                        results[Heap].ms.push_back(walkMs(tree->begin_heap(), tree->end_heap(), n, "heap"));
+                    }
+                    if (wanted[MyHeap] || wanted[HeapAfterMyHeap]) {
+                        start = chrono::steady_clock::now();
+                        tree->myHeap(options.heap_mode);
+                        results[MyHeap].ms.push_back(elapsedMs(start));
+                        if (wanted[HeapAfterMyHeap]) {
+                            results[HeapAfterMyHeap].ms.push_back(walkMs(tree->begin_heap(), tree->end_heap(), n, "heap_after_myHeap"));
+                        }
+                    }
+
+                    start = chrono::steady_clock::now();
+                    delete tree;
+                    results[Destroy].ms.push_back(elapsedMs(start));
+                }
+
+                for (size_t op = 0; op < OpCount; ++op) {
+                    if (wanted[op]) {
+                        reporter.report(results[op]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename T, typename Alloc, typename Index>
+void benchArities(const Options& options, const string& type, const string& alloc, const string& index,
+                  Reporter& reporter) {
+    for (int k : options.arities) {
+        switch (k) {
+            case 1: benchTree<T, 1, Alloc, Index>(options, type, alloc, index, reporter); break;
+            case 2: benchTree<T, 2, Alloc, Index>(options, type, alloc, index, reporter); break;
+            case 3: benchTree<T, 3, Alloc, Index>(options, type, alloc, index, reporter); break;
+            case 8: benchTree<T, 8, Alloc, Index>(options, type, alloc, index, reporter); break;
+        }
+    }
+}
+
+template <typename T, typename Alloc>
+void benchIndexes(const Options& options, const string& type, const string& alloc, Reporter& reporter) {
+    for (const string& index : options.indexes) {
+        if (index == "none") {
+            benchArities<T, Alloc, NoIndex>(options, type, alloc, index, reporter);
+        } else {
+            benchArities<T, Alloc, HashIndex<ValueHash<T>>>(options, type, alloc, index, reporter);
+        }
+    }
+}
+
+template <typename T>
+void benchAllocs(const Options& options, const string& type, Reporter& reporter) {
+    for (const string& alloc : options.allocs) {
+        if (alloc == "new") {
+            benchIndexes<T, NewDeleteAlloc>(options, type, alloc, reporter);
+        } else {
+            benchIndexes<T, ArenaAlloc<>>(options, type, alloc, reporter);
+        }
+    }
+}
+
+// Split a comma separated option value.
+vector<string> splitList(const string& text) {
+    vector<string> items;
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+// Check that every item of a list option is one of the allowed values.
+bool allowed(const vector<string>& items, const vector<string>& choices) {
+    for (const string& item : items) {
+        if (find(choices.begin(), choices.end(), item) == choices.end()) {
+            return false;
+        }
+    }
+    return !items.empty();
+}
+
+void usage() {
+    cerr << "usage: bench [options], where every list is comma separated\n"
+            "  --n LIST       numbers of nodes (default 100000)\n"
+            "  --k LIST       arities, of 1, 2, 3 and 8 (default 2, 3 and 8)\n"
+            "  --shape LIST   tree shapes, of balanced, skewed and random (default all)\n"
+            "  --type LIST    value types, of double, Complex and string (default all)\n"
+            "  --alloc LIST   node allocators, of new and arena (default both)\n"
+            "  --index LIST   parent lookup indexes, of none and hash (default none)\n"
+            "  --insert LIST  build by handle, or by value looking up every parent (default handle);\n"
+            "                 by value without an index takes quadratic time\n"
+            "  --op LIST      operations to report, of build, pre_order, post_order, in_order, bfs_scan,\n"
+            "                 dfs_scan, heap, myHeap, heap_after_myHeap and destroy (default all)\n"
+            "  --reps N       repetitions of every measurement (default 5)\n"
+            "  --heap-mode M  mode of myHeap, sorted, heapify or parallel (default sorted)\n"
+            "  --format F     csv or json (default csv)\n";
+}
+
+// Parse the command line, returning false on any invalid option.
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        string name = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        string value = argv[++i];
+        vector<string> items = splitList(value);
+        if (name == "--n" || name == "--k") {
+            vector<size_t> numbers;
+            for (const string& item : items) {
+                char* end = nullptr;
+                unsigned long number = strtoul(item.c_str(), &end, 10);
+                if (item.empty() || *end || number == 0) {
+                    return false;
+                }
+                numbers.push_back(number);
+            }
+            if (numbers.empty()) {
+                return false;
+            }
+            if (name == "--n") {
+                options.sizes = numbers;
+            } else {
+                options.arities.assign(numbers.begin(), numbers.end());
+                if (!allowed(items, {"1", "2", "3", "8"})) {
+                    return false;
+                }
+            }
+        } else if (name == "--shape" && allowed(items, {"balanced", "skewed", "random"})) {
+            options.shapes = items;
+        } else if (name == "--type" && allowed(items, {"double", "Complex", "string"})) {
+            options.types = items;
+        } else if (name == "--alloc" && allowed(items, {"new", "arena"})) {
+            options.allocs = items;
+        } else if (name == "--index" && allowed(items, {"none", "hash"})) {
+            options.indexes = items;
+        } else if (name == "--insert" && allowed(items, {"handle", "value"})) {
+            options.inserts = items;
+        } else if (name == "--op" && allowed(items, opNames)) {
+            options.ops = items;
+        } else if (name == "--reps") {
+            options.reps = strtoul(value.c_str(), nullptr, 10);
+            if (options.reps == 0) {
+                return false;
+            }
+        } else if (name == "--heap-mode" && items.size() == 1 && allowed(items, {"sorted", "heapify", "parallel"})) {
+            options.heap_mode = value == "heapify" ? HeapMode::Heapify
+                              : value == "parallel" ? HeapMode::ParallelSorted : HeapMode::Sorted;
+        } else if (name == "--format" && items.size() == 1 && allowed(items, {"csv", "json"})) {
+            options.json = value == "json";
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    Reporter reporter(options.json);
+    for (const string& type : options.types) {
+        if (type == "double") {
+            benchAllocs<double>(options, type, reporter);
+        } else if (type == "Complex") {
+            benchAllocs<Complex>(options, type, reporter);
+        } else {
+            benchAllocs<string>(options, type, reporter);
+        }
+    }
+
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include <string>
 #include <QApplication>
 #include "Tree.hpp"
+#include "TreeViewer.hpp"
 #include "Complex.hpp"
 
 using namespace std;
@@ -90,7 +91,10 @@ int main(int argc, char *argv[]) {
     }
     cout << endl;
 
-    cout << tree;
+    cout << tree << endl;
+
+    // Opens a window with the tree once the event loop below runs.
+    show_async(tree);
 
     Tree<Complex, 3> three_ary_tree; // 3-ary tree.
     three_ary_tree.add_root(root_node);
@@ -1,6 +1,13 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 #include "Tree.hpp"
+#include "FlatTree.hpp"
+#include "FlatTreeFile.hpp"
+#include "TreeLayout.hpp"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <type_traits>
 
 // Function to create a sample binary tree
 Tree<double> createSampleBinaryTree() {
@@ -271,4 +278,813 @@ TEST_CASE("Testing Heap Iterator with Complex") {
     }
 
     CHECK(result == expected);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Testing Hash Index") {
+    Tree<double, 2, HashIndex<>> tree;
+    tree.add_root(34.7);
+    tree.add_sub_node(34.7, 45.9);
+    tree.add_sub_node(34.7, 56.8);
+    tree.add_sub_node(45.9, 78.2);
+    tree.add_sub_node(45.9, 89.1);
+    tree.add_sub_node(56.8, 100.5);
+    tree.add_sub_node(34.7, 1.0); // root is full, ignored
+    tree.add_sub_node(2.0, 3.0);  // parent does not exist, ignored
+
+    std::vector<double> expected = {34.7, 45.9, 78.2, 89.1, 56.8, 100.5};
+    std::vector<double> result;
+    for (auto node = tree.begin_pre_order(); node != tree.end_pre_order(); ++node) {
+        result.push_back((*node).get_value());
+    }
+    CHECK(result == expected);
+
+    // Replacing the root value re-keys the root in the index.
+    tree.add_root(10.0);
+    tree.add_sub_node(34.7, 1.0);
+    tree.add_sub_node(100.5, 200.0);
+    tree.add_sub_node(10.0, 2.0); // root is still full
+    expected = {10.0, 45.9, 78.2, 89.1, 56.8, 100.5, 200.0};
+    result.clear();
+    for (auto node = tree.begin_pre_order(); node != tree.end_pre_order(); ++node) {
+        result.push_back((*node).get_value());
+    }
+    CHECK(result == expected);
+
+    // Replacing the root keeps the entry of a descendant with the old root value.
+    Tree<int, 2, HashIndex<>> duplicates;
+    duplicates.add_root(5);
+    duplicates.add_sub_node(5, 5);
+    duplicates.add_root(6);
+    CHECK(duplicates.add_sub_node(5, 7));
+    std::vector<int> values;
+    for (auto node = duplicates.begin_pre_order(); node != duplicates.end_pre_order(); ++node) {
+        values.push_back((*node).get_value());
+    }
+    CHECK(values == std::vector<int>({6, 5, 7}));
+
+    // Values changed in place are found again after reindex().
+    (*duplicates.begin_pre_order()).set_value(8);
+    CHECK_FALSE(duplicates.add_sub_node(8, 9));
+    duplicates.reindex();
+    CHECK(duplicates.add_sub_node(8, 9));
+    CHECK(duplicates.size() == 4);
+
+    // set_value() re-keys the node by itself.
+    auto leaf = duplicates.add_sub_node(9, 12);
+    duplicates.set_value(leaf, 20);
+    CHECK_FALSE(duplicates.add_sub_node(12, 13));
+    CHECK(duplicates.add_sub_node(20, 13));
+}
+
+TEST_CASE("Testing Node Handles") {
+    Tree<double> tree;
+    auto root = tree.add_root(34.7);
+    auto n1 = tree.add_sub_node(root, 45.9);
+    auto n2 = tree.add_sub_node(root, 56.8);
+    tree.add_sub_node(n1, 78.2);
+    tree.add_sub_node(n1, 89.1);
+    auto n5 = tree.add_sub_node(n2, 100.5);
+
+    CHECK(n5);
+    CHECK((*n5).get_value() == 100.5);
+    CHECK(n1->get_value() == 45.9);
+    CHECK_FALSE(tree.add_sub_node(root, 1.0)); // root is full
+    CHECK_FALSE(tree.add_sub_node(Tree<double>::NodeHandle(), 1.0));
+    CHECK(tree.add_root(10.0) == root);
+
+    std::vector<double> expected = {10.0, 45.9, 78.2, 89.1, 56.8, 100.5};
+    std::vector<double> result;
+    for (auto node = tree.begin_pre_order(); node != tree.end_pre_order(); ++node) {
+        result.push_back((*node).get_value());
+    }
+    CHECK(result == expected);
+}
+
+TEST_CASE("Testing Arena Allocator") {
+    Tree<std::string, 3, NoIndex, ArenaAlloc<2>> tree; // tiny blocks to cross block boundaries
+    auto root = tree.add_root(std::string("root"));
+    auto a = tree.add_sub_node(root, std::string("a"));
+    auto b = tree.add_sub_node(root, std::string("b"));
+    tree.add_sub_node(a, std::string("a1"));
+    tree.add_sub_node(std::string("b"), std::string("b1"));
+    tree.add_sub_node(b, std::string("b2"));
+
+    std::vector<std::string> expected = {"root", "a", "b", "a1", "b1", "b2"};
+    std::vector<std::string> result;
+    for (auto node = tree.begin_bfs_scan(); node != tree.end_bfs_scan(); ++node) {
+        result.push_back((*node).get_value());
+    }
+    CHECK(result == expected);
+}
+
+TEST_CASE("Testing Wide Tree With Vector Children") {
+    Tree<int, 12> tree; // K above the inline limit keeps children in a vector
+    auto root = tree.add_root(0);
+    for (int i = 1; i <= 13; ++i) {
+        tree.add_sub_node(root, i); // the 13th child is ignored
+    }
+
+    std::vector<int> expected = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    std::vector<int> result;
+    for (auto node = tree.begin_pre_order(); node != tree.end_pre_order(); ++node) {
+        result.push_back((*node).get_value());
+    }
+    CHECK(result == expected);
+}
+
+TEST_CASE("Testing Flat Tree Iterators") {
+    Tree<double> tree = createSampleBinaryTree();
+    FlatTree<double> flat(tree);
+    CHECK(flat.size() == 6);
+    CHECK(flat.parent(0) == FlatTree<double>::npos);
+    CHECK(flat.child_count(0) == 2);
+    CHECK(flat.value(flat.first_child(0)).get_value() == 45.9);
+
+    std::vector<double> pre, post, in, bfs, dfs, heap;
+    for (auto node = flat.begin_pre_order(); node != flat.end_pre_order(); ++node) pre.push_back((*node).get_value());
+    for (auto node = flat.begin_post_order(); node != flat.end_post_order(); ++node) post.push_back((*node).get_value());
+    for (auto node = flat.begin_in_order(); node != flat.end_in_order(); ++node) in.push_back((*node).get_value());
+    for (auto node = flat.begin_bfs_scan(); node != flat.end_bfs_scan(); ++node) bfs.push_back((*node).get_value());
+    for (auto node = flat.begin_dfs_scan(); node != flat.end_dfs_scan(); ++node) dfs.push_back((*node).get_value());
+    for (auto node = flat.begin_heap(); node != flat.end_heap(); ++node) heap.push_back((*node).get_value());
+
+    CHECK(pre == std::vector<double>({34.7, 45.9, 78.2, 89.1, 56.8, 100.5}));
+    CHECK(post == std::vector<double>({78.2, 89.1, 45.9, 100.5, 56.8, 34.7}));
+    CHECK(in == std::vector<double>({78.2, 45.9, 89.1, 34.7, 100.5, 56.8}));
+    CHECK(bfs == std::vector<double>({34.7, 45.9, 56.8, 78.2, 89.1, 100.5}));
+    CHECK(dfs == pre);
+    CHECK(heap == bfs);
+
+    FlatTree<double> empty{Tree<double>()};
+    CHECK(empty.empty());
+    CHECK_FALSE(empty.begin_pre_order() != empty.end_pre_order());
+    CHECK_FALSE(empty.begin_heap() != empty.end_heap());
+}
+
+TEST_CASE("Testing 3-Ary Flat Tree Iterators") {
+    Tree<double, 3> tree = createSampleThreeAryTree();
+    FlatTree<double, 3> flat(tree);
+
+    std::vector<double> expected = {34.7, 45.9, 89.1, 56.8, 100.5, 78.2};
+    std::vector<double> pre, post, in;
+    for (auto node = flat.begin_pre_order(); node != flat.end_pre_order(); ++node) pre.push_back((*node).get_value());
+    for (auto node = flat.begin_post_order(); node != flat.end_post_order(); ++node) post.push_back((*node).get_value());
+    for (auto node = flat.begin_in_order(); node != flat.end_in_order(); ++node) in.push_back((*node).get_value());
+
+    CHECK(pre == expected);
+    CHECK(post == expected);
+    CHECK(in == expected);
+}
+
+// Build an irregular tree by attaching each new node to a pseudo-random earlier node with room left.
+template <int K>
+void buildIrregularTree(Tree<int, K>& tree, int count) {
+    std::vector<typename Tree<int, K>::NodeHandle> handles;
+    handles.push_back(tree.add_root(0));
+    unsigned seed = 12345;
+    for (int i = 1; i < count; ++i) {
+        typename Tree<int, K>::NodeHandle child;
+        while (!child) {
+            seed = seed * 1103515245u + 12345u;
+            child = tree.add_sub_node(handles[(seed >> 8) % handles.size()], i);
+        }
+        handles.push_back(child);
+    }
+}
+
+template <typename Begin, typename End>
+std::vector<int> collect(Begin node, End end) {
+    std::vector<int> result;
+    for (; node != end; ++node) {
+        result.push_back((*node).get_value());
+    }
+    return result;
+}
+
+TEST_CASE("Testing Iterators On Irregular Trees") {
+    Tree<int> binary;
+    buildIrregularTree(binary, 200);
+    FlatTree<int> flat_binary(binary);
+    CHECK(collect(binary.begin_pre_order(), binary.end_pre_order()) == collect(flat_binary.begin_pre_order(), flat_binary.end_pre_order()));
+    CHECK(collect(binary.begin_post_order(), binary.end_post_order()) == collect(flat_binary.begin_post_order(), flat_binary.end_post_order()));
+    CHECK(collect(binary.begin_in_order(), binary.end_in_order()) == collect(flat_binary.begin_in_order(), flat_binary.end_in_order()));
+    CHECK(collect(binary.begin_bfs_scan(), binary.end_bfs_scan()) == collect(flat_binary.begin_bfs_scan(), flat_binary.end_bfs_scan()));
+    CHECK(collect(binary.begin_dfs_scan(), binary.end_dfs_scan()) == collect(flat_binary.begin_dfs_scan(), flat_binary.end_dfs_scan()));
+
+    Tree<int, 4> wide;
+    buildIrregularTree(wide, 200);
+    FlatTree<int, 4> flat_wide(wide);
+    CHECK(collect(wide.begin_pre_order(), wide.end_pre_order()) == collect(flat_wide.begin_pre_order(), flat_wide.end_pre_order()));
+    CHECK(collect(wide.begin_post_order(), wide.end_post_order()) == collect(flat_wide.begin_post_order(), flat_wide.end_post_order()));
+    CHECK(collect(wide.begin_bfs_scan(), wide.end_bfs_scan()) == collect(flat_wide.begin_bfs_scan(), flat_wide.end_bfs_scan()));
+
+    // Copies are independent positions in the same walk.
+    auto it = binary.begin_bfs_scan();
+    ++it;
+    ++it;
+    auto copy = it;
+    ++it;
+    CHECK(collect(copy, binary.end_bfs_scan()).size() == 198);
+    CHECK(collect(it, binary.end_bfs_scan()).size() == 197);
+}
+
+TEST_CASE("Testing BFS Iterator On Deep Trees") {
+    // Scanning level by level from the root would take quadratic time on a chain.
+    Tree<int> chain;
+    auto node = chain.add_root(0);
+    for (int i = 1; i < 200000; ++i) {
+        node = chain.add_sub_node(node, i);
+    }
+    std::vector<int> order = collect(chain.begin_bfs_scan(), chain.end_bfs_scan());
+    CHECK(order.size() == 200000);
+    CHECK(order.back() == 199999);
+
+    // A caller-supplied buffer gives the same order and can be reused.
+    Tree<int, 4> wide;
+    buildIrregularTree(wide, 5000);
+    Tree<int, 4>::BFSBuffer buffer;
+    std::vector<int> expected = collect(wide.begin_bfs_scan(), wide.end_bfs_scan());
+    CHECK(collect(wide.begin_bfs_scan(buffer), wide.end_bfs_scan()) == expected);
+    CHECK(collect(wide.begin_bfs_scan(buffer), wide.end_bfs_scan()) == expected);
+}
+
+TEST_CASE("Testing Post-Order Iterator Early Exit") {
+    // A deep chain where node i has the leaf -(i+1) as its first child and node i+1 as its second.
+    Tree<int> tree;
+    auto node = tree.add_root(0);
+    for (int i = 1; i < 100000; ++i) {
+        tree.add_sub_node(node, -i);
+        node = tree.add_sub_node(node, i);
+    }
+    auto it = tree.begin_post_order();
+    CHECK((*it).get_value() == -1);
+    ++it;
+    CHECK((*it).get_value() == -2);
+
+    std::vector<int> last;
+    for (auto post = tree.begin_post_order(); post != tree.end_post_order(); ++post) {
+        last.push_back((*post).get_value());
+    }
+    CHECK(last.size() == 199999);
+    CHECK(last.back() == 0);
+    CHECK(last[last.size() - 2] == 1);
+}
+
+TEST_CASE("Testing Lazy Heap Iterator") {
+    Tree<int> tree;
+    buildIrregularTree(tree, 500);
+
+    std::vector<int> expected(500);
+    for (int i = 0; i < 500; ++i) expected[i] = i;
+    CHECK(collect(tree.begin_heap(), tree.end_heap()) == expected);
+
+    // The iterator refers to the nodes of the tree, not to copies.
+    auto smallest = tree.begin_heap();
+    CHECK(&*smallest == &*tree.begin_pre_order());
+
+    // After myHeap only the frontier is kept, and the order stays the same.
+    tree.myHeap();
+    CHECK(collect(tree.begin_heap(), tree.end_heap()) == expected);
+
+    // New nodes fall back to the full heap.
+    tree.add_sub_node(499, -1);
+    expected.insert(expected.begin(), -1);
+    CHECK(collect(tree.begin_heap(), tree.end_heap()) == expected);
+}
+
+TEST_CASE("Testing Top-K Queries") {
+    Tree<int, 3> tree;
+    std::vector<Tree<int, 3>::NodeHandle> handles;
+    handles.push_back(tree.add_root(0));
+    for (int i = 1; i < 10000; ++i) {
+        handles.push_back(tree.add_sub_node(handles[(i - 1) / 3], (i * 7919) % 10000)); // a permutation of 0..9999
+    }
+
+    std::vector<int> smallest, largest, parallel;
+    for (Node<int>& node : tree.smallest_k(5)) smallest.push_back(node.get_value());
+    for (Node<int>& node : tree.largest_k(3)) largest.push_back(node.get_value());
+    for (Node<int>& node : tree.smallest_k(100, 4)) parallel.push_back(node.get_value());
+
+    CHECK(smallest == std::vector<int>({0, 1, 2, 3, 4}));
+    CHECK(largest == std::vector<int>({9999, 9998, 9997}));
+    CHECK(parallel.size() == 100);
+    CHECK(parallel.front() == 0);
+    CHECK(parallel.back() == 99);
+    CHECK(tree.smallest_k(20000).size() == 10000);
+    CHECK(tree.largest_k(20000, 4).front().get().get_value() == 9999);
+
+    // The results refer to the nodes of the tree.
+    tree.smallest_k(1)[0].get().set_value(-1);
+    CHECK(tree.smallest_k(1)[0].get().get_value() == -1);
+}
+
+TEST_CASE("Testing myHeap Modes") {
+    std::vector<int> expected(1000);
+    for (int i = 0; i < 1000; ++i) expected[i] = i;
+
+    Tree<int> heapified;
+    buildIrregularTree(heapified, 1000);
+    heapified.myHeap(HeapMode::Heapify);
+    CHECK(collect(heapified.begin_heap(), heapified.end_heap()) == expected);
+    // Every node is no smaller than its parent.
+    FlatTree<int> flat(heapified);
+    bool ordered = true;
+    for (std::uint32_t i = 1; i < flat.size(); ++i) {
+        ordered = ordered && flat.value(flat.parent(i)) <= flat.value(i);
+    }
+    CHECK(ordered);
+
+    Tree<int> sorted;
+    buildIrregularTree(sorted, 1000);
+    sorted.myHeap(HeapMode::ParallelSorted, 3);
+    CHECK(collect(sorted.begin_bfs_scan(), sorted.end_bfs_scan()) == expected);
+}
+
+TEST_CASE("Testing Destruction Of Deep Trees") {
+    // Recursive teardown would overflow the stack on a chain this long.
+    Tree<int, 1>* chain = new Tree<int, 1>();
+    auto node = chain->add_root(0);
+    for (int i = 1; i < 1000000; ++i) {
+        node = chain->add_sub_node(node, i);
+    }
+    CHECK(collect(chain->begin_post_order(), chain->end_post_order()).size() == 1000000);
+    delete chain;
+}
+
+TEST_CASE("Testing Search And myHeap On Deep Trees") {
+    // Recursive helpers would overflow the stack on a chain this deep.
+    Tree<int> tree;
+    auto node = tree.add_root(0);
+    for (int i = 1; i < 1000000; ++i) {
+        node = tree.add_sub_node(node, i);
+    }
+    CHECK(tree.add_sub_node(999999, -1)); // finds the deepest node by value
+    CHECK_FALSE(tree.add_sub_node(1000000, -2));
+
+    tree.myHeap();
+    auto smallest = tree.smallest_k(3);
+    CHECK(smallest[0].get().get_value() == -1);
+    CHECK(collect(tree.begin_bfs_scan(), tree.end_bfs_scan()).size() == 1000001);
+    CHECK((*tree.begin_bfs_scan()).get_value() == -1);
+}
+
+// A payload that counts how often it is copied.
+struct Payload {
+    static int copies;
+    std::string text;
+    Payload(const std::string& text, int repeat) : text(repeat, text[0]) {}
+    Payload(const Payload& other) : text(other.text) { ++copies; }
+    Payload(Payload&& other) : text(std::move(other.text)) {}
+    Payload& operator=(const Payload& other) { text = other.text; ++copies; return *this; }
+    Payload& operator=(Payload&& other) { text = std::move(other.text); return *this; }
+    bool operator==(const Payload& other) const { return text == other.text; }
+    bool operator<(const Payload& other) const { return text < other.text; }
+    friend std::ostream& operator<<(std::ostream& os, const Payload& p) { return os << p.text; }
+};
+int Payload::copies = 0;
+
+TEST_CASE("Testing Emplace And Move Semantics") {
+    Payload::copies = 0;
+    Tree<Payload> tree;
+    auto root = tree.emplace_root("r", 1000);
+    auto a = tree.emplace_child(root, "a", 1000);
+    tree.emplace_child(a, "c", 3);
+    tree.add_sub_node(root, Payload("b", 1000));          // moved in
+    tree.emplace_child(Node<Payload>(Payload("b", 1000)), "d", 2); // parent found by value
+    tree.emplace_root("s", 2);                             // replaces the root value
+    CHECK(Payload::copies == 0);
+
+    std::vector<std::string> result;
+    for (auto node = tree.begin_pre_order(); node != tree.end_pre_order(); ++node) {
+        const Payload& value = (*node).get_value(); // no copy either
+        result.push_back(value.text.substr(0, 2));
+    }
+    CHECK(Payload::copies == 0);
+    CHECK(result == std::vector<std::string>({"ss", "aa", "cc", "bb", "dd"}));
+}
+
+TEST_CASE("Testing Copy, Move And Clone") {
+    Tree<int> original;
+    buildIrregularTree(original, 1000);
+    std::vector<int> expected = collect(original.begin_pre_order(), original.end_pre_order());
+    CHECK(original.size() == 1000);
+
+    Tree<int> copy(original);
+    Tree<int> parallel = original.clone(4);
+    CHECK(collect(copy.begin_pre_order(), copy.end_pre_order()) == expected);
+    CHECK(collect(parallel.begin_pre_order(), parallel.end_pre_order()) == expected);
+    CHECK(collect(parallel.begin_bfs_scan(), parallel.end_bfs_scan()) == collect(original.begin_bfs_scan(), original.end_bfs_scan()));
+    CHECK(parallel.size() == 1000);
+
+    // Copies are independent.
+    (*copy.begin_pre_order()).set_value(-1);
+    CHECK((*original.begin_pre_order()).get_value() == 0);
+
+    Tree<int> moved(std::move(copy));
+    CHECK(copy.empty());
+    CHECK(copy.size() == 0);
+    CHECK(moved.size() == 1000);
+    CHECK((*moved.begin_pre_order()).get_value() == -1);
+
+    moved = original;
+    CHECK(collect(moved.begin_pre_order(), moved.end_pre_order()) == expected);
+    moved = Tree<int>();
+    CHECK(moved.empty());
+
+    Tree<int, 2, HashIndex<>, ArenaAlloc<64>> arena;
+    auto root = arena.add_root(1);
+    arena.add_sub_node(root, 2);
+    Tree<int, 2, HashIndex<>, ArenaAlloc<64>> arena_copy = arena.clone(4); // arena copies on one thread
+    arena_copy.add_sub_node(2, 3); // the copy has its own index
+    Tree<int, 2, HashIndex<>, ArenaAlloc<64>> arena_moved;
+    arena_moved = std::move(arena_copy);
+    CHECK(collect(arena_moved.begin_pre_order(), arena_moved.end_pre_order()) == std::vector<int>({1, 2, 3}));
+    CHECK(collect(arena.begin_pre_order(), arena.end_pre_order()) == std::vector<int>({1, 2}));
+
+    // Moves cannot throw, so growing a vector of trees moves them instead of copying every node.
+    CHECK(std::is_nothrow_move_constructible<Tree<int>>::value);
+    CHECK(std::is_nothrow_move_assignable<Tree<int>>::value);
+    CHECK(std::is_nothrow_move_constructible<Tree<int, 2, HashIndex<>, ArenaAlloc<64>>>::value);
+    CHECK(std::is_nothrow_move_constructible<FlatTree<int>>::value);
+    Payload::copies = 0;
+    std::vector<Tree<Payload>> trees;
+    for (int i = 0; i < 20; ++i) {
+        trees.emplace_back();
+        trees.back().emplace_root("t", 10);
+    }
+    CHECK(Payload::copies == 0);
+}
+
+// A value whose copies start failing after a set number, counting the live instances.
+struct Fragile {
+    static std::atomic<int> live;        // atomic, as clone() copies on several threads
+    static std::atomic<int> copies_left;
+    Fragile() { ++live; }
+    Fragile(const Fragile&) {
+        if (copies_left-- <= 0) throw std::runtime_error("copy failed");
+        ++live;
+    }
+    ~Fragile() { --live; }
+    bool operator==(const Fragile&) const { return true; }
+    bool operator<(const Fragile&) const { return false; }
+};
+std::atomic<int> Fragile::live(0);
+std::atomic<int> Fragile::copies_left(0);
+
+TEST_CASE("Testing Bulk Construction") {
+    std::vector<double> level_order = {34.7, 45.9, 56.8, 78.2, 89.1, 100.5};
+    Tree<double> tree = Tree<double>::from_level_order(level_order.begin(), level_order.end());
+    std::vector<double> pre;
+    for (auto node = tree.begin_pre_order(); node != tree.end_pre_order(); ++node) {
+        pre.push_back((*node).get_value());
+    }
+    CHECK(pre == std::vector<double>({34.7, 45.9, 78.2, 89.1, 56.8, 100.5}));
+    CHECK(tree.size() == 6);
+
+    Tree<int, 3, HashIndex<>, ArenaAlloc<>> ternary = Tree<int, 3, HashIndex<>, ArenaAlloc<>>::from_level_order(level_order.begin(), level_order.begin() + 5);
+    ternary.add_sub_node(56, 7); // the index knows the bulk-built nodes
+    CHECK(collect(ternary.begin_pre_order(), ternary.end_pre_order()) == std::vector<int>({34, 45, 89, 56, 7, 78}));
+
+    // 2 is the root; 0 and 3 are its children, 1 is a child of 0.
+    Tree<int> from_parents = Tree<int>::from_parent_array({10, 11, 12, 13}, {2, 0, -1, 2});
+    CHECK(collect(from_parents.begin_pre_order(), from_parents.end_pre_order()) == std::vector<int>({12, 10, 11, 13}));
+    CHECK(Tree<int>::from_parent_array({}, {}).empty());
+
+    CHECK_THROWS_AS(Tree<int>::from_parent_array({1, 2}, {-1}), std::invalid_argument);
+    CHECK_THROWS_AS(Tree<int>::from_parent_array({1, 2}, {-1, 5}), std::invalid_argument);
+    CHECK_THROWS_AS(Tree<int>::from_parent_array({1, 2}, {-1, -1}), std::invalid_argument);
+    CHECK_THROWS_AS(Tree<int>::from_parent_array({1, 2, 3, 4}, {-1, 0, 0, 0}), std::invalid_argument);
+    CHECK_THROWS_AS(Tree<int>::from_parent_array({1, 2, 3, 4}, {-1, 2, 3, 1}), std::invalid_argument);
+
+    // A value that fails to copy part-way through leaves no node behind.
+    Fragile::live = 0;
+    std::vector<Fragile> fragile(5);
+    Fragile::copies_left = 3;
+    CHECK_THROWS_AS(Tree<Fragile>::from_parent_array(fragile, {-1, 0, 0, 1, 1}), std::runtime_error);
+    CHECK(Fragile::live == 5);
+}
+
+TEST_CASE("Testing Copy With Failing Values") {
+    // A value that fails to copy part-way through leaves no node of the copy behind.
+    typedef Tree<Fragile, 3> FragileTree;
+    Fragile::live = 0;
+    Fragile::copies_left = 1000;
+    {
+        FragileTree original;
+        std::vector<FragileTree::NodeHandle> nodes(1, original.emplace_root());
+        for (int i = 1; i < 200; ++i) {
+            nodes.push_back(original.emplace_child(nodes[(i - 1) / 3]));
+        }
+        CHECK(Fragile::live == 200);
+
+        Fragile::copies_left = 50;
+        CHECK_THROWS_AS(FragileTree{original}, std::runtime_error);
+        CHECK(Fragile::live == 200);
+
+        FragileTree target;
+        Fragile::copies_left = 120;
+        CHECK_THROWS_AS(target = original, std::runtime_error);
+        CHECK(Fragile::live == 200);
+        CHECK(target.empty());
+
+        // Workers pass their exception on instead of terminating.
+        Fragile::copies_left = 100;
+        CHECK_THROWS_AS(original.clone(4), std::runtime_error);
+        CHECK(Fragile::live == 200);
+    }
+    CHECK(Fragile::live == 0);
+}
+
+TEST_CASE("Testing Binary Save And Mapped Loading") {
+    Tree<int> tree;
+    buildIrregularTree(tree, 200);
+    const std::string path = "test_tree.bin";
+    tree.save(path);
+
+    FlatTree<int> mapped = FlatTree<int>::map_file(path);
+    FlatTree<int> flat(tree);
+    CHECK(mapped.size() == tree.size());
+    CHECK(collect(mapped.begin_pre_order(), mapped.end_pre_order()) == collect(tree.begin_pre_order(), tree.end_pre_order()));
+    CHECK(collect(mapped.begin_in_order(), mapped.end_in_order()) == collect(tree.begin_in_order(), tree.end_in_order()));
+    CHECK(collect(mapped.begin_post_order(), mapped.end_post_order()) == collect(tree.begin_post_order(), tree.end_post_order()));
+    CHECK(collect(mapped.begin_bfs_scan(), mapped.end_bfs_scan()) == collect(flat.begin_bfs_scan(), flat.end_bfs_scan()));
+
+    // Copies share the mapping, which outlives the original.
+    FlatTree<int> copy = mapped;
+    mapped = FlatTree<int>();
+    CHECK(mapped.empty());
+    CHECK(collect(copy.begin_heap(), copy.end_heap()) == collect(flat.begin_heap(), flat.end_heap()));
+
+    // The file records the arity and value size it was saved with.
+    CHECK_THROWS_AS((FlatTree<int, 3>::map_file(path)), std::runtime_error);
+    CHECK_THROWS_AS(FlatTree<double>::map_file(path), std::runtime_error);
+    CHECK_THROWS_AS(FlatTree<int>::map_file("missing_tree.bin"), std::runtime_error);
+
+    // A valid header over damaged links is refused rather than read out of bounds.
+    {
+        std::fstream file(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        const std::uint32_t bad = 1000000;
+        file.seekp(32 + 200 * sizeof(Node<int>) + 5 * sizeof(std::uint32_t)); // the parent of node 5
+        file.write(reinterpret_cast<const char*>(&bad), sizeof(bad));
+    }
+    CHECK_THROWS_AS(FlatTree<int>::map_file(path), std::runtime_error);
+    {
+        std::ofstream file(path.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(32);
+        file.write(std::string(200 * sizeof(Node<int>) + 3 * 200 * sizeof(std::uint32_t), '\0').data(),
+                   200 * sizeof(Node<int>) + 3 * 200 * sizeof(std::uint32_t));
+    }
+    CHECK_THROWS_AS(FlatTree<int>::map_file(path), std::runtime_error);
+    std::remove(path.c_str());
+
+    Tree<Complex, 3> complex_tree;
+    auto root = complex_tree.add_root(Complex(1, 2));
+    complex_tree.add_sub_node(root, Complex(3, 4));
+    complex_tree.add_sub_node(root, Complex(5, 6));
+    complex_tree.save(path);
+    FlatTree<Complex, 3> complex_mapped = FlatTree<Complex, 3>::map_file(path);
+    CHECK(complex_mapped.size() == 3);
+    CHECK(complex_mapped.value(2).get_value() == Complex(5, 6));
+    CHECK(complex_mapped.parent(2) == 0);
+    std::remove(path.c_str());
+
+    Tree<double>().save(path);
+    CHECK(FlatTree<double>::map_file(path).empty());
+    std::remove(path.c_str());
+
+    // Over-aligned values cannot be saved, but still get a flat copy, e.g. for the viewer.
+    Tree<long double> long_tree;
+    long_tree.add_sub_node(long_tree.add_root(1.5L), 2.5L);
+    FlatTree<long double> long_flat(long_tree);
+    CHECK(long_flat.value(1).get_value() == 2.5L);
+}
+
+TEST_CASE("Testing Text Export And Import") {
+    Tree<double> tree = createSampleBinaryTree();
+    std::ostringstream out;
+    tree.write_text(out);
+    Tree<int, 3> small;
+    auto small_root = small.add_root(7);
+    small.add_sub_node(small.add_sub_node(small_root, 8), 9);
+    small.add_sub_node(small_root, 10);
+    std::ostringstream small_text;
+    small.write_text(small_text);
+    CHECK(small_text.str() == "0 -1 7\n1 0 8\n2 1 9\n3 0 10\n");
+
+    std::istringstream in(out.str());
+    Tree<double> read = Tree<double>::read_text(in);
+    std::vector<double> original, copy;
+    for (auto node = tree.begin_pre_order(); node != tree.end_pre_order(); ++node) original.push_back((*node).get_value());
+    for (auto node = read.begin_pre_order(); node != read.end_pre_order(); ++node) copy.push_back((*node).get_value());
+    CHECK(copy == original);
+
+    // Full precision, irregular shapes and other value types survive a round trip.
+    Tree<int, 4> wide;
+    buildIrregularTree(wide, 300);
+    std::stringstream wide_text;
+    wide.write_text(wide_text);
+    Tree<int, 4> wide_read = Tree<int, 4>::read_text(wide_text);
+    CHECK(wide_read.size() == 300);
+    CHECK(collect(wide_read.begin_bfs_scan(), wide_read.end_bfs_scan()) == collect(wide.begin_bfs_scan(), wide.end_bfs_scan()));
+
+    Tree<Complex, 3> complex_tree;
+    auto complex_root = complex_tree.add_root(Complex(0.1, -2.5));
+    complex_tree.add_sub_node(complex_root, Complex(1.0 / 3, 4));
+    std::stringstream complex_text;
+    complex_tree.write_text(complex_text);
+    Tree<Complex, 3> complex_read = Tree<Complex, 3>::read_text(complex_text);
+    CHECK(complex_read.root_handle()->get_value() == Complex(0.1, -2.5));
+    CHECK(complex_read.root_handle().child(0)->get_value() == Complex(1.0 / 3, 4));
+
+    Tree<std::string> strings;
+    auto greeting = strings.add_root(std::string("hello world"));
+    strings.add_sub_node(greeting, std::string(""));
+    std::stringstream string_text;
+    strings.write_text(string_text);
+    Tree<std::string> strings_read = Tree<std::string>::read_text(string_text);
+    CHECK(strings_read.root_handle()->get_value() == "hello world");
+    CHECK(strings_read.root_handle().child(0)->get_value() == "");
+
+    std::istringstream empty_text("\n");
+    CHECK(Tree<int>::read_text(empty_text).empty());
+    std::istringstream bad_line("0 -1 1\n1 x 2\n");
+    CHECK_THROWS_AS(Tree<int>::read_text(bad_line), std::runtime_error);
+    std::istringstream two_roots("0 -1 1\n1 -1 2\n");
+    CHECK_THROWS_AS(Tree<int>::read_text(two_roots), std::runtime_error);
+    std::istringstream unknown_parent("0 -1 1\n1 0 2\n2 1 3\n3 7 4\n");
+    CHECK_THROWS_AS(Tree<int>::read_text(unknown_parent), std::runtime_error);
+    std::istringstream full_parent("0 -1 1\n1 0 2\n2 0 3\n3 0 4\n");
+    CHECK_THROWS_AS(Tree<int>::read_text(full_parent), std::runtime_error);
+}
+
+// Check that every parent is centred above its children and that nodes on a level keep the gap.
+template <typename T, int K>
+void checkLayout(const FlatTree<T, K>& flat, const TreeLayout& layout, double gap) {
+    REQUIRE(layout.size() == flat.size());
+    for (std::uint32_t i = 0; i < flat.size(); ++i) {
+        if (flat.child_count(i) > 0) {
+            std::uint32_t first = flat.first_child(i), last = first + flat.child_count(i) - 1;
+            CHECK(layout.x(i) == doctest::Approx((layout.x(first) + layout.x(last)) / 2));
+        }
+        // BFS order lists each level from left to right.
+        if (i > 0 && layout.y(i) == layout.y(i - 1)) {
+            CHECK(layout.x(i) - layout.x(i - 1) >= gap - 1e-9);
+        }
+        CHECK(layout.x(i) >= 0);
+        CHECK(layout.x(i) <= layout.width() + 1e-9);
+    }
+}
+
+TEST_CASE("Testing Tree Layout") {
+    std::vector<int> values = {1, 2, 3, 4, 5, 6, 7};
+    Tree<int> complete = Tree<int>::from_level_order(values.begin(), values.end());
+    FlatTree<int> flat(complete);
+    TreeLayout layout(flat, 2.0, 3.0);
+    std::vector<double> xs, ys;
+    for (std::uint32_t i = 0; i < layout.size(); ++i) {
+        xs.push_back(layout.x(i));
+        ys.push_back(layout.y(i));
+    }
+    CHECK(xs == std::vector<double>({3, 1, 5, 0, 2, 4, 6}));
+    CHECK(ys == std::vector<double>({0, 3, 3, 6, 6, 6, 6}));
+    CHECK(layout.width() == 6);
+    CHECK(layout.height() == 6);
+
+    // A small subtree between two deep ones is centred in the space they leave.
+    Tree<int, 3> ternary;
+    auto root = ternary.add_root(0);
+    auto left = ternary.add_sub_node(root, 1);
+    ternary.add_sub_node(root, 2);
+    auto right = ternary.add_sub_node(root, 3);
+    for (int i = 0; i < 3; ++i) {
+        ternary.add_sub_node(left, 10 + i);
+        ternary.add_sub_node(right, 20 + i);
+    }
+    FlatTree<int, 3> flat_ternary(ternary);
+    TreeLayout ternary_layout(flat_ternary);
+    checkLayout(flat_ternary, ternary_layout, 1.0);
+    CHECK(ternary_layout.x(2) == doctest::Approx((ternary_layout.x(1) + ternary_layout.x(3)) / 2));
+
+    Tree<int> irregular;
+    buildIrregularTree(irregular, 2000);
+    FlatTree<int> flat_irregular(irregular);
+    checkLayout(flat_irregular, TreeLayout(flat_irregular, 1.5), 1.5);
+
+    Tree<int, 5> wide;
+    buildIrregularTree(wide, 2000);
+    FlatTree<int, 5> flat_wide(wide);
+    checkLayout(flat_wide, TreeLayout(flat_wide), 1.0);
+
+    CHECK(TreeLayout(FlatTree<int>()).size() == 0);
+}
+
+TEST_CASE("Testing DOT And SVG Export") {
+    Tree<std::string, 3> tree;
+    auto root = tree.add_root(std::string("say \"hi\""));
+    tree.add_sub_node(root, std::string("a<b & c"));
+    tree.add_sub_node(root, std::string("back\\slash"));
+
+    std::ostringstream dot;
+    tree.write_dot(dot);
+    CHECK(dot.str().find("  n0 [label=\"say \\\"hi\\\"\"];\n") != std::string::npos);
+    CHECK(dot.str().find("  n2 [label=\"back\\\\slash\"];\n  n0 -> n2;\n") != std::string::npos);
+    CHECK(dot.str().substr(dot.str().size() - 2) == "}\n");
+
+    std::ostringstream svg;
+    svg.precision(3);
+    tree.write_svg(svg);
+    CHECK(svg.precision() == 3); // the stream settings are restored
+    CHECK(svg.str().find("<svg ") == 0);
+    CHECK(svg.str().find(">a&lt;b &amp; c</text>") != std::string::npos);
+    CHECK(svg.str().find("<path d=\"M80 40L40 100M80 40L120 100\"/>") != std::string::npos);
+
+    // Long edge lists are split into several paths; every node gets a box.
+    Tree<int> big;
+    buildIrregularTree(big, 10000);
+    std::ostringstream big_svg;
+    big.write_svg(big_svg);
+    std::string text = big_svg.str();
+    size_t paths = 0, rects = 0;
+    for (size_t pos = text.find("<path"); pos != std::string::npos; pos = text.find("<path", pos + 1)) ++paths;
+    for (size_t pos = text.find("<rect"); pos != std::string::npos; pos = text.find("<rect", pos + 1)) ++rects;
+    CHECK(paths == 3);
+    CHECK(rects == 10000);
+
+    std::ostringstream empty;
+    Tree<int>().write_svg(empty);
+    CHECK(empty.str().find("<path") == std::string::npos);
+
+    // Both are written straight from the nodes, without copying any value.
+    Tree<Payload> payloads;
+    auto top = payloads.emplace_root("r", 3);
+    payloads.emplace_child(top, "a", 2);
+    payloads.emplace_child(top, "b", 2);
+    Payload::copies = 0;
+    std::ostringstream payload_dot, payload_svg;
+    payloads.write_dot(payload_dot);
+    payloads.write_svg(payload_svg);
+    CHECK(Payload::copies == 0);
+    CHECK(payload_dot.str().find("  n0 -> n2;\n") != std::string::npos);
+    CHECK(payload_svg.str().find(">bb</text>") != std::string::npos);
+}
+
+TEST_CASE("Testing Text Output Operator") {
+    Tree<double> tree = createSampleBinaryTree();
+    std::ostringstream out;
+    out << tree;
+    CHECK(out.str() == "34.7[45.9[78.2, 89.1], 56.8[100.5]]");
+
+    Tree<Complex, 3> complex_tree;
+    auto root = complex_tree.add_root(Complex(1, 1));
+    auto child = complex_tree.add_sub_node(root, Complex(2, 2));
+    complex_tree.add_sub_node(child, Complex(3, 3));
+    complex_tree.add_sub_node(root, Complex(4, 4));
+    std::ostringstream complex_out;
+    complex_out << complex_tree;
+    CHECK(complex_out.str() == "(1, 1)[(2, 2)[(3, 3)], (4, 4)]");
+
+    std::ostringstream empty_out;
+    empty_out << Tree<int>() << ' ' << Node<int>(5);
+    CHECK(empty_out.str() == "[] 5");
+
+    // Deep trees print without recursion.
+    Tree<int, 1> chain;
+    auto node = chain.add_root(0);
+    for (int i = 1; i < 100000; ++i) {
+        node = chain.add_sub_node(node, i % 10);
+    }
+    std::ostringstream chain_out;
+    chain_out << chain;
+    CHECK(chain_out.str().size() == 3 * 100000 - 2);
+}
+
+TEST_CASE("Testing Snapshot Source") {
+    std::shared_ptr<SnapshotSource<int, 2>> source;
+    {
+        Tree<int> tree;
+        auto root = tree.add_root(1);
+        source = tree.snapshot_source();
+        CHECK(tree.snapshot_source() == source);
+        CHECK_FALSE(source->changed);
+
+        tree.add_sub_node(root, 2);
+        CHECK(source->changed.exchange(false));
+        FlatTree<int> snapshot = source->take();
+        CHECK(snapshot.size() == 2);
+        CHECK(snapshot.value(1).get_value() == 2);
+
+        // set_value() is a change like any other.
+        tree.set_value(root, 3);
+        CHECK(source->changed.exchange(false));
+        CHECK(source->take().value(0).get_value() == 3);
+
+        tree.myHeap();
+        CHECK(source->changed.exchange(false));
+        tree = Tree<int>();
+        CHECK(source->changed.exchange(false));
+        CHECK(source->take().empty());
+    }
+    // The source outlives the tree but no longer takes snapshots.
+    CHECK(source->changed);
+    CHECK_FALSE(source->take);
+}